@@ -0,0 +1,115 @@
+// Reports output bytes per terminal cell for each render mode and color
+// depth, with and without color coalescing, on a smooth synthetic picture,
+// on random noise, and on the smooth picture as a one-channel gray image. Half blocks get twice the pixel rows in the same cells,
+// Braille twice the columns and four times the rows, and shapes 4x8 pixels.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/image.h"
+#include "../include/frame.h"
+#include "../include/print_image.h"
+#include "../include/pacer.h"
+
+#define WIDTH 200
+#define HEIGHT 60
+#define N_ROUNDS 50
+
+
+typedef enum {
+    PICTURE_SMOOTH,
+    PICTURE_NOISE,
+    PICTURE_GRAY
+} picture_t;
+
+
+// Sky-like gradient with a few flat shapes, or uniform noise, or the
+// gradient's luminance alone
+static image_t make_picture(size_t width, size_t height, picture_t picture) {
+    int is_noise = picture == PICTURE_NOISE;
+    image_t image = {width, height, 3, malloc(sizeof(double) * 3 * width * height)};
+    if (!image.data)
+        return image;
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            double* pixel = &image.data[(y * width + x) * 3];
+            if (is_noise) {
+                for (size_t c = 0; c < 3; c++)
+                    pixel[c] = (rand() % 256) / 255.0;
+                continue;
+            }
+
+            double u = (double) x / width, v = (double) y / height;
+            pixel[0] = 0.2 + 0.3 * v;
+            pixel[1] = 0.4 + 0.3 * v;
+            pixel[2] = 0.9 - 0.2 * v;
+            if (hypot(u - 0.3, v - 0.4) < 0.15)
+                pixel[0] = 1.0, pixel[1] = 0.8, pixel[2] = 0.2;
+            if (v > 0.75 + 0.05 * sin(u * 12.0))
+                pixel[0] = 0.1, pixel[1] = 0.5 + 0.1 * sin(u * 40.0), pixel[2] = 0.15;
+        }
+    }
+
+    if (picture == PICTURE_GRAY) {
+        for (size_t i = 0; i < width * height; i++) {
+            const double* pixel = &image.data[i * 3];
+            image.data[i] = 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
+        }
+        image.channels = 1;
+
+        // Shrunk to fit, so reading past one channel per pixel shows up
+        double* shrunk = realloc(image.data, sizeof(double) * width * height);
+        if (shrunk)
+            image.data = shrunk;
+    }
+    return image;
+}
+
+
+int main(void) {
+    const char* depth_names[] = {"truecolor", "256", "16"};
+    const char* picture_names[] = {"smooth", "noise", "gray"};
+    const char* mode_names[] = {"ascii", "half-blocks", "braille", "shapes"};
+    const size_t pixels_across[] = {1, 1, 2, 4};
+    const size_t pixels_down[] = {1, 2, 4, 8};
+
+    srand(1);
+    printf("%-8s %-12s %-10s %10s %14s %10s\n", "picture", "mode", "colors", "bytes/cell", "uncoalesced", "ms/frame");
+
+    for (picture_t picture = PICTURE_SMOOTH; picture <= PICTURE_GRAY; picture++) {
+        for (render_mode_t mode = RENDER_ASCII; mode <= RENDER_SHAPES; mode++) {
+            image_t image = make_picture(WIDTH * pixels_across[mode], HEIGHT * pixels_down[mode], picture);
+            if (!image.data)
+                return 1;
+
+            for (color_depth_t depth = COLORS_TRUECOLOR; depth <= COLORS_16; depth++) {
+                args_t args = {
+                    .edge_threshold = 4.0,
+                    .color_depth = depth,
+                    .render_mode = mode,
+                    .n_threads = 1
+                };
+
+                frame_t frame = make_frame(1 << 20);
+                double start = get_seconds();
+                for (size_t round = 0; round < N_ROUNDS; round++) {
+                    clear_frame(&frame);
+                    frame.saved_bytes = 0;
+                    render_image(&image, &args, &frame, NULL);
+                }
+                double seconds = get_seconds() - start;
+
+                size_t n_cells = WIDTH * HEIGHT;
+                printf("%-8s %-12s %-10s %10.2f %14.2f %10.3f\n",
+                    picture_names[picture], mode_names[mode], depth_names[depth],
+                    (double) frame.length / n_cells, (double) (frame.length + frame.saved_bytes) / n_cells,
+                    seconds / N_ROUNDS * 1e3);
+                free_frame(&frame);
+            }
+            free_image(&image);
+        }
+    }
+
+    return 0;
+}
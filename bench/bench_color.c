@@ -0,0 +1,109 @@
+// Measures RGB->HSV and HSV->RGB row conversion on each instruction set the
+// CPU supports, for hsv_t rows and for planar rows, and checks every kernel
+// is bit-identical to the scalar one.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/color.h"
+#include "../include/pacer.h"
+
+#define N_PIXELS 4096
+#define N_ROUNDS 2000
+
+
+int main(void) {
+    double* pixels = malloc(sizeof(double) * 3 * N_PIXELS);
+    double* reference_rgb = malloc(sizeof(double) * 3 * N_PIXELS);
+    double* rgb = malloc(sizeof(double) * 3 * N_PIXELS);
+    hsv_t* reference_hsvs = malloc(sizeof(hsv_t) * N_PIXELS);
+    hsv_t* hsvs = malloc(sizeof(hsv_t) * N_PIXELS);
+    hsv_planes_t planes = {
+        malloc(sizeof(double) * N_PIXELS),
+        malloc(sizeof(double) * N_PIXELS),
+        malloc(sizeof(double) * N_PIXELS)
+    };
+    if (!pixels || !reference_rgb || !rgb || !reference_hsvs || !hsvs
+        || !planes.hues || !planes.saturations || !planes.values)
+        return 1;
+
+    // Random colors, plus greys and ties between channels to hit every branch
+    srand(1);
+    for (size_t i = 0; i < 3 * N_PIXELS; i++) {
+        pixels[i] = (rand() % 256) / 255.0;
+    }
+    for (size_t i = 0; i < N_PIXELS; i += 7) {
+        pixels[i * 3 + 1] = pixels[i * 3 + (i / 7) % 3];
+    }
+    for (size_t i = 0; i < N_PIXELS; i += 11) {
+        pixels[i * 3 + 1] = pixels[i * 3 + 2] = pixels[i * 3];
+    }
+
+    rgb_to_hsv_row_isa(COLOR_ISA_SCALAR, pixels, 3, reference_hsvs, N_PIXELS);
+    hsv_to_rgb_row_isa(COLOR_ISA_SCALAR, reference_hsvs, reference_rgb, N_PIXELS);
+
+    int failed = 0;
+    for (color_isa_t isa = COLOR_ISA_SCALAR; isa <= get_color_isa(); isa++) {
+        double start = get_seconds();
+        for (size_t round = 0; round < N_ROUNDS; round++) {
+            rgb_to_hsv_row_isa(isa, pixels, 3, hsvs, N_PIXELS);
+        }
+        double to_hsv = get_seconds() - start;
+
+        start = get_seconds();
+        for (size_t round = 0; round < N_ROUNDS; round++) {
+            hsv_to_rgb_row_isa(isa, reference_hsvs, rgb, N_PIXELS);
+        }
+        double to_rgb = get_seconds() - start;
+
+        int same = !memcmp(hsvs, reference_hsvs, sizeof(hsv_t) * N_PIXELS)
+            && !memcmp(rgb, reference_rgb, sizeof(double) * 3 * N_PIXELS);
+        failed |= !same;
+
+        printf("%-8s hsv_t    rgb->hsv %8.1f Mpx/s   hsv->rgb %8.1f Mpx/s   %s\n",
+            get_color_isa_name(isa),
+            (double) N_PIXELS * N_ROUNDS / to_hsv / 1e6,
+            (double) N_PIXELS * N_ROUNDS / to_rgb / 1e6,
+            same ? "identical" : "MISMATCH");
+    }
+
+    for (color_isa_t isa = COLOR_ISA_SCALAR; isa <= get_color_isa(); isa++) {
+        double start = get_seconds();
+        for (size_t round = 0; round < N_ROUNDS; round++) {
+            rgb_to_hsv_planes_isa(isa, pixels, 3, planes, N_PIXELS);
+        }
+        double to_hsv = get_seconds() - start;
+
+        int same = 1;
+        for (size_t i = 0; i < N_PIXELS; i++) {
+            hsv_t hsv = {planes.hues[i], planes.saturations[i], planes.values[i]};
+            same &= !memcmp(&hsv, &reference_hsvs[i], sizeof(hsv_t));
+        }
+
+        start = get_seconds();
+        for (size_t round = 0; round < N_ROUNDS; round++) {
+            hsv_to_rgb_planes_isa(isa, planes, rgb, N_PIXELS);
+        }
+        double to_rgb = get_seconds() - start;
+
+        same &= !memcmp(rgb, reference_rgb, sizeof(double) * 3 * N_PIXELS);
+        failed |= !same;
+
+        printf("%-8s planar   rgb->hsv %8.1f Mpx/s   hsv->rgb %8.1f Mpx/s   %s\n",
+            get_color_isa_name(isa),
+            (double) N_PIXELS * N_ROUNDS / to_hsv / 1e6,
+            (double) N_PIXELS * N_ROUNDS / to_rgb / 1e6,
+            same ? "identical" : "MISMATCH");
+    }
+
+    free(pixels);
+    free(reference_rgb);
+    free(rgb);
+    free(reference_hsvs);
+    free(hsvs);
+    free(planes.hues);
+    free(planes.saturations);
+    free(planes.values);
+
+    return failed;
+}
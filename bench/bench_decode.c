@@ -0,0 +1,63 @@
+// Compares full-resolution decode + resize with load_resized, which decodes
+// JPEGs at reduced DCT scale when the output grid allows it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/image.h"
+#include "../include/pacer.h"
+
+#define N_RUNS 3
+
+
+int main(int argc, char* argv[]) {
+    const char* file_path = argc > 1 ? argv[1] : "examples/waterfall.jpg";
+    size_t max_width = argc > 2 ? (size_t) atoi(argv[2]) : 120;
+    size_t max_height = argc > 3 ? (size_t) atoi(argv[3]) : 60;
+
+    image_t reference = {0}, resized = {0};
+
+    double start = get_seconds();
+    for (size_t i = 0; i < N_RUNS; i++) {
+        image_u8_t original = load_image_u8(file_path);
+        if (!original.data)
+            return 1;
+        free_image(&reference);
+        reference = make_resized_u8(&original, max_width, max_height, 2.0);
+        free_image_u8(&original);
+    }
+    double full_time = (get_seconds() - start) / N_RUNS;
+
+    start = get_seconds();
+    for (size_t i = 0; i < N_RUNS; i++) {
+        free_image(&resized);
+        resized = load_resized(file_path, max_width, max_height, 2.0, 1);
+        if (!resized.data)
+            return 1;
+    }
+    double scaled_time = (get_seconds() - start) / N_RUNS;
+
+    if (reference.width != resized.width || reference.height != resized.height) {
+        fprintf(stderr, "Error: Output sizes differ!\n");
+        return 1;
+    }
+
+    size_t n_samples = reference.width * reference.height * reference.channels;
+    double max_error = 0.0, total_error = 0.0;
+    for (size_t i = 0; i < n_samples; i++) {
+        double error = fabs(reference.data[i] - resized.data[i]) * 255.0;
+        total_error += error;
+        if (error > max_error)
+            max_error = error;
+    }
+
+    printf("%s -> %zux%zu\n", file_path, resized.width, resized.height);
+    printf("full decode   %8.2f ms\n", full_time * 1e3);
+    printf("scaled decode %8.2f ms\n", scaled_time * 1e3);
+    printf("difference (0-255): mean %.3f, max %.3f\n", total_error / n_samples, max_error);
+
+    free_image(&reference);
+    free_image(&resized);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Compares per-cell printf output against the buffered frame writer.
+// Both paths encode the same synthetic 300x100 grid and write it to /dev/null.
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../include/frame.h"
+#include "../include/pacer.h"
+
+#define WIDTH 300
+#define HEIGHT 100
+#define N_FRAMES 200
+
+typedef struct {
+    char ascii;
+    int r, g, b;
+} cell_t;
+
+
+static void report(const char* name, size_t bytes, double seconds) {
+    printf("%-8s %10.1f frames/s %10.1f MB/s (%zu bytes/frame)\n",
+        name, N_FRAMES / seconds, bytes * N_FRAMES / seconds / 1e6, bytes);
+}
+
+
+int main(void) {
+    const char* chars = " .-=+*x#$&X@";
+    cell_t* cells = malloc(sizeof(*cells) * WIDTH * HEIGHT);
+    if (!cells)
+        return 1;
+
+    srand(1);
+    for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+        cells[i] = (cell_t) {chars[rand() % 12], rand() % 256, rand() % 256, rand() % 256};
+    }
+
+    FILE* null_file = fopen("/dev/null", "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (!null_file || null_fd < 0) {
+        fprintf(stderr, "Error: Failed to open /dev/null!\n");
+        return 1;
+    }
+
+    // Current path: one printf per cell
+    size_t printf_bytes = 0;
+    double start = get_seconds();
+    for (size_t f = 0; f < N_FRAMES; f++) {
+        printf_bytes = 0;
+        for (size_t y = 0; y < HEIGHT; y++) {
+            for (size_t x = 0; x < WIDTH; x++) {
+                cell_t* cell = &cells[y * WIDTH + x];
+                printf_bytes += fprintf(null_file, "\x1b[38;2;%d;%d;%dm%c", cell->r, cell->g, cell->b, cell->ascii);
+            }
+            printf_bytes += fprintf(null_file, "\n");
+        }
+        fflush(null_file);
+    }
+    report("printf", printf_bytes, get_seconds() - start);
+
+    // Frame writer: one reused buffer, one write per frame
+    frame_t frame = make_frame(0);
+    start = get_seconds();
+    for (size_t f = 0; f < N_FRAMES; f++) {
+        clear_frame(&frame);
+        for (size_t y = 0; y < HEIGHT; y++) {
+            for (size_t x = 0; x < WIDTH; x++) {
+                cell_t* cell = &cells[y * WIDTH + x];
+                frame_append_fg_color(&frame, cell->r, cell->g, cell->b);
+                frame_append_char(&frame, cell->ascii);
+            }
+            frame_append_char(&frame, '\n');
+        }
+        write_frame(&frame, null_fd);
+    }
+    report("frame", frame.length, get_seconds() - start);
+
+    free_frame(&frame);
+    fclose(null_file);
+    close(null_fd);
+    free(cells);
+
+    return 0;
+}
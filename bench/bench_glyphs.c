@@ -0,0 +1,53 @@
+// Measures shape matching against the printable ascii glyphs on each
+// instruction set the CPU supports, and checks every kernel picks the same
+// characters as the scalar one.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/glyphs.h"
+#include "../include/pacer.h"
+
+#define N_CELLS (200 * 60)
+#define N_ROUNDS 200
+
+
+int main(void) {
+    uint32_t* patterns = malloc(sizeof(uint32_t) * N_CELLS);
+    char* reference = malloc(N_CELLS);
+    char* chars = malloc(N_CELLS);
+    if (!patterns || !reference || !chars)
+        return 1;
+
+    // Random patterns, plus empty and full cells
+    srand(1);
+    for (size_t i = 0; i < N_CELLS; i++)
+        patterns[i] = (uint32_t) rand() << 16 ^ (uint32_t) rand();
+    for (size_t i = 0; i < N_CELLS; i += 13)
+        patterns[i] = i % 2 ? 0xffffffff : 0;
+
+    match_glyph_row_isa(COLOR_ISA_SCALAR, patterns, reference, N_CELLS);
+
+    int failed = 0;
+    for (color_isa_t isa = COLOR_ISA_SCALAR; isa <= get_color_isa(); isa++) {
+        double start = get_seconds();
+        for (size_t round = 0; round < N_ROUNDS; round++)
+            match_glyph_row_isa(isa, patterns, chars, N_CELLS);
+        double seconds = get_seconds() - start;
+
+        int same = !memcmp(chars, reference, N_CELLS);
+        failed |= !same;
+
+        printf("%-8s %8.1f Mcells/s   %6.3f ms per 200x60 frame   %s\n",
+            get_color_isa_name(isa),
+            (double) N_CELLS * N_ROUNDS / seconds / 1e6,
+            seconds / N_ROUNDS * 1e3,
+            same ? "identical" : "MISMATCH");
+    }
+
+    free(patterns);
+    free(reference);
+    free(chars);
+
+    return failed;
+}
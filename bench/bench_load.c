@@ -0,0 +1,106 @@
+// Compares loading images through stb_image's stdio reader, reading the
+// whole file into a buffer, and memory-mapping it (load_image_u8). Writes
+// uncompressed BMPs from 100 KB to 200 MB, where the copy matters most.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/stb_image.h"
+#include "../include/image.h"
+#include "../include/file_map.h"
+#include "../include/pacer.h"
+
+#define MAX_BYTES_PER_CASE (400u << 20)
+
+
+static void put_u32(unsigned char* out, unsigned int value) {
+    out[0] = value & 0xFF, out[1] = value >> 8 & 0xFF, out[2] = value >> 16 & 0xFF, out[3] = value >> 24;
+}
+
+
+// Writes a 24-bit square BMP of about `size` bytes. Returns its size.
+static size_t write_bmp(const char* file_path, size_t size) {
+    size_t side = 1;
+    while ((side + 1) * (side + 1) * 3 < size)
+        side++;
+    size_t row_bytes = (side * 3 + 3) & ~(size_t) 3;
+    size_t file_size = 54 + row_bytes * side;
+
+    unsigned char header[54] = {'B', 'M'};
+    put_u32(header + 2, (unsigned int) file_size);
+    put_u32(header + 10, 54);
+    put_u32(header + 14, 40);
+    put_u32(header + 18, (unsigned int) side);
+    put_u32(header + 22, (unsigned int) side);
+    header[26] = 1;
+    header[28] = 24;
+
+    FILE* file = fopen(file_path, "wb");
+    unsigned char* row = malloc(row_bytes);
+    if (!file || !row)
+        return 0;
+
+    fwrite(header, 1, sizeof(header), file);
+    for (size_t y = 0; y < side; y++) {
+        for (size_t i = 0; i < row_bytes; i++)
+            row[i] = (unsigned char) (i * 7 + y * 3);
+        fwrite(row, 1, row_bytes, file);
+    }
+
+    free(row);
+    fclose(file);
+    return file_size;
+}
+
+
+int main(void) {
+    const size_t sizes[] = {100u << 10, 1u << 20, 10u << 20, 50u << 20, 200u << 20};
+    const char* file_path = "/tmp/bench_load.bmp";
+
+    printf("%10s %6s %12s %12s %12s\n", "size", "runs", "stdio MB/s", "read MB/s", "mmap MB/s");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t file_size = write_bmp(file_path, sizes[s]);
+        if (!file_size) {
+            fprintf(stderr, "Error: Failed to write '%s'!\n", file_path);
+            return 1;
+        }
+        size_t n_runs = MAX_BYTES_PER_CASE / file_size;
+        if (n_runs < 2)
+            n_runs = 2;
+
+        // First pass warms the page cache so every method reads from memory
+        image_u8_t warm = load_image_u8(file_path);
+        free_image_u8(&warm);
+
+        double start = get_seconds();
+        for (size_t i = 0; i < n_runs; i++) {
+            int width, height, channels;
+            stbi_image_free(stbi_load(file_path, &width, &height, &channels, 0));
+        }
+        double stdio_time = get_seconds() - start;
+
+        start = get_seconds();
+        for (size_t i = 0; i < n_runs; i++) {
+            int width, height, channels;
+            size_t length;
+            unsigned char* buffer = read_file(file_path, &length);
+            stbi_image_free(stbi_load_from_memory(buffer, (int) length, &width, &height, &channels, 0));
+            free(buffer);
+        }
+        double read_time = get_seconds() - start;
+
+        start = get_seconds();
+        for (size_t i = 0; i < n_runs; i++) {
+            image_u8_t image = load_image_u8(file_path);
+            free_image_u8(&image);
+        }
+        double mmap_time = get_seconds() - start;
+
+        double megabytes = (double) file_size * n_runs / 1e6;
+        printf("%8.1fMB %6zu %12.0f %12.0f %12.0f\n", file_size / 1e6, n_runs,
+            megabytes / stdio_time, megabytes / read_time, megabytes / mmap_time);
+    }
+
+    remove(file_path);
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Compares make_resized (per-cell get_average over doubles, the reference)
+// with make_resized_u8 (summed-area table over 8-bit samples).
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/image.h"
+#include "../include/pacer.h"
+
+#define N_RUNS 5
+
+
+int main(int argc, char* argv[]) {
+    const char* file_path = argc > 1 ? argv[1] : "examples/waterfall.jpg";
+    size_t max_width = argc > 2 ? (size_t) atoi(argv[2]) : 120;
+    size_t max_height = argc > 3 ? (size_t) atoi(argv[3]) : 60;
+
+    image_t original = load_image(file_path);
+    image_u8_t original_u8 = load_image_u8(file_path);
+    if (!original.data || !original_u8.data)
+        return 1;
+
+    printf("%s: %zux%zu -> at most %zux%zu\n", file_path, original.width, original.height, max_width, max_height);
+
+    image_t reference = {0}, resized = {0};
+
+    double start = get_seconds();
+    for (size_t i = 0; i < N_RUNS; i++) {
+        free_image(&reference);
+        reference = make_resized(&original, max_width, max_height, 2.0);
+    }
+    double reference_time = (get_seconds() - start) / N_RUNS;
+
+    start = get_seconds();
+    for (size_t i = 0; i < N_RUNS; i++) {
+        free_image(&resized);
+        resized = make_resized_u8(&original_u8, max_width, max_height, 2.0);
+    }
+    double table_time = (get_seconds() - start) / N_RUNS;
+
+    double max_error = 0.0;
+    for (size_t i = 0; i < reference.width * reference.height * reference.channels; i++) {
+        double error = fabs(reference.data[i] - resized.data[i]);
+        if (error > max_error)
+            max_error = error;
+    }
+
+    printf("get_average   %8.2f ms\n", reference_time * 1e3);
+    printf("summed-area   %8.2f ms\n", table_time * 1e3);
+    printf("max difference: %g\n", max_error);
+
+    free_image(&original);
+    free_image_u8(&original_u8);
+    free_image(&reference);
+    free_image(&resized);
+
+    return max_error < 1e-9 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// Compares the two-pass Sobel (get_sobel into two planes, then magnitude and
+// atan2 per pixel) with the fused single-pass get_edge_chars. Also checks that
+// get_sobel_edge_char puts every gradient in the same bin as the atan2 path.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/image.h"
+#include "../include/print_image.h"
+#include "../include/pacer.h"
+
+#define WIDTH 300
+#define HEIGHT 100
+#define N_RUNS 200
+#define EDGE_THRESHOLD 1.0
+
+
+// Returns number of gradients get_sobel_edge_char bins differently from atan2
+static size_t check_edge_chars(void) {
+    size_t n_mismatches = 0;
+
+    // Every integer gradient, which includes the axes, diagonals and zero
+    for (int sy = -512; sy <= 512; sy++) {
+        for (int sx = -512; sx <= 512; sx++) {
+            char expected = get_sobel_angle_char(atan2(sy, sx) * 180. / M_PI);
+            n_mismatches += get_sobel_edge_char(sx, sy) != expected;
+        }
+    }
+
+    // Fine sweep of angles on either side of every bin boundary. Points exactly
+    // on a boundary are skipped: there atan2's rounding and the ratio test can
+    // each settle the tie either way.
+    for (int boundary = -8; boundary <= 8; boundary++) {
+        for (int step = -1000; step <= 1000; step++) {
+            if (step == 0)
+                continue;
+            double angle = (22.5 + 45.0 * boundary) * M_PI / 180.0 + step * 1e-9;
+            double sx = cos(angle), sy = sin(angle);
+            char expected = get_sobel_angle_char(atan2(sy, sx) * 180. / M_PI);
+            n_mismatches += get_sobel_edge_char(sx, sy) != expected;
+        }
+    }
+
+    // Signed zeros
+    double zeros[] = {0.0, -0.0};
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            n_mismatches += get_sobel_edge_char(zeros[i], zeros[j]) != get_sobel_angle_char(atan2(zeros[j], zeros[i]) * 180. / M_PI);
+        }
+        n_mismatches += get_sobel_edge_char(zeros[i], 1.0) != get_sobel_angle_char(atan2(1.0, zeros[i]) * 180. / M_PI);
+        n_mismatches += get_sobel_edge_char(zeros[i], -1.0) != get_sobel_angle_char(atan2(-1.0, zeros[i]) * 180. / M_PI);
+        n_mismatches += get_sobel_edge_char(-1.0, zeros[i]) != get_sobel_angle_char(atan2(zeros[i], -1.0) * 180. / M_PI);
+    }
+
+    return n_mismatches;
+}
+
+
+int main(void) {
+    image_t grayscale = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .channels = 1,
+        .data = malloc(WIDTH * HEIGHT * sizeof(double))
+    };
+    double* sobel_x = calloc(WIDTH * HEIGHT, sizeof(*sobel_x));
+    double* sobel_y = calloc(WIDTH * HEIGHT, sizeof(*sobel_y));
+    char* two_pass = malloc(WIDTH * HEIGHT);
+    char* fused = malloc(WIDTH * HEIGHT);
+    if (!grayscale.data || !sobel_x || !sobel_y || !two_pass || !fused)
+        return 1;
+
+    srand(1);
+    for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+        grayscale.data[i] = rand() / (double) RAND_MAX;
+    }
+
+    double start = get_seconds();
+    for (size_t run = 0; run < N_RUNS; run++) {
+        get_sobel(&grayscale, sobel_x, sobel_y);
+        for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+            double sx = sobel_x[i], sy = sobel_y[i];
+            double sobel_angle = atan2(sy, sx) * 180. / M_PI;
+            two_pass[i] = (sx * sx + sy * sy >= EDGE_THRESHOLD * EDGE_THRESHOLD) ? get_sobel_angle_char(sobel_angle) : 0;
+        }
+    }
+    double two_pass_time = (get_seconds() - start) / N_RUNS;
+
+    start = get_seconds();
+    for (size_t run = 0; run < N_RUNS; run++) {
+        for (size_t y = 0; y < HEIGHT; y++) {
+            get_edge_chars(&grayscale, y, EDGE_THRESHOLD, &fused[y * WIDTH]);
+        }
+    }
+    double fused_time = (get_seconds() - start) / N_RUNS;
+
+    size_t n_mismatches = 0;
+    for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+        n_mismatches += two_pass[i] != fused[i];
+    }
+
+    printf("two-pass %8.1f us/frame\n", two_pass_time * 1e6);
+    printf("fused    %8.1f us/frame\n", fused_time * 1e6);
+    printf("mismatched cells: %zu of %d\n", n_mismatches, WIDTH * HEIGHT);
+
+    size_t n_bad_bins = check_edge_chars();
+    printf("edge orientation bins differing from atan2: %zu\n", n_bad_bins);
+
+    free(grayscale.data);
+    free(sobel_x);
+    free(sobel_y);
+    free(two_pass);
+    free(fused);
+
+    return n_mismatches != 0 || n_bad_bins != 0;
+}
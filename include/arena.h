@@ -0,0 +1,26 @@
+#ifndef MY_ARENA
+#define MY_ARENA
+#include <stdlib.h>
+
+// Bump allocator for scratch memory that lives as long as one render.
+// Allocations that don't fit get blocks of their own, and the next reset
+// replaces everything with one block of the peak size, so a run of renders
+// of the same size stops allocating after the first. Not thread-safe: each
+// thread uses its own. A zeroed arena_t is empty and ready to use.
+typedef struct arena_block arena_block_t;
+
+typedef struct {
+    unsigned char* data;
+    size_t capacity;
+    size_t used;
+    arena_block_t* overflow; // Blocks taken since the last reset
+    size_t overflow_bytes;
+    size_t peak; // Most bytes handed out between two resets
+    size_t n_allocations; // Blocks ever taken from malloc
+} arena_t;
+
+void* arena_alloc(arena_t* arena, size_t size);
+void reset_arena(arena_t* arena);
+void free_arena(arena_t* arena);
+
+#endif
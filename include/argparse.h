@@ -2,16 +2,55 @@
 #define MY_ARGPARSE
 #include <stdlib.h>
 
+// Encoding of the rendered glyph/color grid, picked by the -o file extension
+typedef enum {
+    OUTPUT_ANSI,
+    OUTPUT_TEXT,
+    OUTPUT_HTML
+} output_format_t;
+
+// Colors the terminal is sent: 24-bit, xterm's 256-color palette, or the basic 16
+typedef enum {
+    COLORS_TRUECOLOR,
+    COLORS_256,
+    COLORS_16
+} color_depth_t;
+
+// What each terminal cell shows: a glyph chosen by brightness, the upper and
+// lower half of the cell in two colors, a 2x4 grid of Braille dots, or the
+// ascii character whose shape best matches a 4x8 grid of pixels
+typedef enum {
+    RENDER_ASCII,
+    RENDER_HALF_BLOCKS,
+    RENDER_BRAILLE,
+    RENDER_SHAPES
+} render_mode_t;
 
 typedef struct {
     char* file_path;
-    size_t max_width;
-    size_t max_height;
-    double character_ratio;
+    char** input_paths; // file_path and any further paths, for batch mode
+    size_t n_inputs;
+    char* batch_dir;
+    char* output_path;
+    output_format_t output_format;
+    size_t max_width; // In pixels, which are cells for ascii and half blocks
+    size_t max_height; // In pixel rows, e.g. twice the cell rows for half blocks
+    double character_ratio; // Of a pixel, so half the character's for half blocks
     double edge_threshold;
     int use_retro_colors;
+    color_depth_t color_depth;
+    render_mode_t render_mode;
     int use_rainbow_colors;
+    int use_full_redraw;
+    double fps;
+    int print_stats;
+    int use_stream;
+    int use_cache;
+    char* cache_dir;
+    size_t cache_size; // MiB
+    size_t n_threads;
 } args_t;
 
 args_t parse_args(int argc, char* argv[]);
+const char* get_output_extension(output_format_t format);
 #endif
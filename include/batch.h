@@ -0,0 +1,7 @@
+#ifndef MY_BATCH
+#define MY_BATCH
+#include "argparse.h"
+
+int run_batch(const args_t* args);
+
+#endif
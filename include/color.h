@@ -0,0 +1,42 @@
+#ifndef MY_COLOR
+#define MY_COLOR
+#include <stdlib.h>
+
+typedef struct {
+    double hue;
+    double saturation;
+    double value;
+} hsv_t;
+
+// A row of HSV colors with each component in its own plane, so passes
+// over one component only read that one
+typedef struct {
+    double* hues;
+    double* saturations;
+    double* values;
+} hsv_planes_t;
+
+// Instruction sets the row kernels can run on, in increasing order
+typedef enum {
+    COLOR_ISA_SCALAR,
+    COLOR_ISA_SSE4,
+    COLOR_ISA_AVX2
+} color_isa_t;
+
+hsv_t rgb_to_hsv(double red, double green, double blue);
+void hsv_to_rgb(const hsv_t* hsv, double* r, double* g, double* b);
+
+color_isa_t get_color_isa(void);
+const char* get_color_isa_name(color_isa_t isa);
+
+void rgb_to_hsv_row(const double* pixels, size_t channels, hsv_t* out, size_t n);
+void hsv_to_rgb_row(const hsv_t* hsvs, double* out, size_t n);
+void rgb_to_hsv_row_isa(color_isa_t isa, const double* pixels, size_t channels, hsv_t* out, size_t n);
+void hsv_to_rgb_row_isa(color_isa_t isa, const hsv_t* hsvs, double* out, size_t n);
+
+void rgb_to_hsv_planes(const double* pixels, size_t channels, hsv_planes_t out, size_t n);
+void hsv_to_rgb_planes(hsv_planes_t hsvs, double* out, size_t n);
+void rgb_to_hsv_planes_isa(color_isa_t isa, const double* pixels, size_t channels, hsv_planes_t out, size_t n);
+void hsv_to_rgb_planes_isa(color_isa_t isa, hsv_planes_t hsvs, double* out, size_t n);
+
+#endif
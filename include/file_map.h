@@ -0,0 +1,17 @@
+#ifndef MY_FILE_MAP
+#define MY_FILE_MAP
+#include <stdlib.h>
+
+// Contents of a whole file, either memory-mapped or read into a buffer
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    int is_mapped;
+} file_map_t;
+
+file_map_t map_file(const char* file_path);
+void unmap_file(file_map_t* file);
+
+unsigned char* read_file(const char* file_path, size_t* length);
+
+#endif
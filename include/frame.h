@@ -0,0 +1,49 @@
+#ifndef MY_FRAME
+#define MY_FRAME
+#include <stdlib.h>
+
+// Growable byte buffer that a whole frame is formatted into before being
+// written out with a single write(2).
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+
+    // Last colors emitted, so repeated escapes can be skipped
+    int has_fg;
+    int fg_r, fg_g, fg_b;
+    int fg_index; // Palette index, or -1 for a 24-bit color
+    int has_bg;
+    int bg_r, bg_g, bg_b;
+    int bg_index;
+    size_t saved_bytes;
+} frame_t;
+
+frame_t make_frame(size_t capacity);
+void free_frame(frame_t* frame);
+frame_t copy_frame(const frame_t* frame);
+
+void clear_frame(frame_t* frame);
+int reserve_frame(frame_t* frame, size_t extra);
+
+void frame_append_char(frame_t* frame, char c);
+void frame_append_string(frame_t* frame, const char* string);
+void frame_append_uint(frame_t* frame, size_t value);
+void frame_append_fg_color(frame_t* frame, int r, int g, int b);
+void frame_set_fg_color(frame_t* frame, int r, int g, int b);
+void frame_set_fg_256(frame_t* frame, int index);
+void frame_set_fg_16(frame_t* frame, int index);
+void frame_set_bg_color(frame_t* frame, int r, int g, int b);
+void frame_set_bg_256(frame_t* frame, int index);
+void frame_set_bg_16(frame_t* frame, int index);
+void frame_reset_bg(frame_t* frame);
+void frame_reset_colors(frame_t* frame);
+void frame_set_html_color(frame_t* frame, int r, int g, int b);
+void frame_set_html_colors(frame_t* frame, int r, int g, int b, int bg_r, int bg_g, int bg_b);
+void frame_close_html_span(frame_t* frame);
+void frame_append_html_char(frame_t* frame, char c);
+void frame_move_cursor(frame_t* frame, size_t from_row, size_t from_column, size_t to_row, size_t to_column);
+
+int write_frame(frame_t* frame, int fd);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef MY_GLYPHS
+#define MY_GLYPHS
+#include <stdlib.h>
+#include <stdint.h>
+#include "color.h"
+
+// Shapes are compared on a 4x8 grid of samples per character, packed into
+// 32 bits with bit (row * GLYPH_WIDTH + column) set where there is ink
+#define GLYPH_WIDTH 4
+#define GLYPH_HEIGHT 8
+
+void match_glyph_row(const uint32_t* patterns, char* out, size_t n);
+void match_glyph_row_isa(color_isa_t isa, const uint32_t* patterns, char* out, size_t n);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MY_IMAGE_LIB
 #define MY_IMAGE_LIB
 #include <stdlib.h>
+#include <stdio.h>
 
 typedef struct {
     size_t width;
@@ -9,17 +10,55 @@ typedef struct {
     double* data;
 } image_t;
 
+// Image with 8-bit samples, as decoded. Used for the full-resolution source
+// so it never has to be widened to doubles.
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t channels;
+    unsigned char* data;
+} image_u8_t;
+
+// Frames of an animated image, stored one after another, with the time
+// each one is shown for in milliseconds
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t channels;
+    size_t n_frames;
+    unsigned char* data;
+    int* delays;
+} animation_t;
+
 image_t load_image(const char* file_path);
 void free_image(image_t* image);
 
+image_u8_t load_image_u8(const char* file_path);
+void free_image_u8(image_u8_t* image);
+
+animation_t load_animation(const char* file_path);
+void free_animation(animation_t* animation);
+
+image_t load_resized(const char* file_path, size_t max_width, size_t max_height, double character_ratio, size_t n_threads);
+image_t load_resized_from_memory(const unsigned char* buffer, size_t length, const char* name,
+                                 size_t max_width, size_t max_height, double character_ratio, size_t n_threads);
+image_t load_resized_from_stream(FILE* file, const char* name,
+                                 size_t max_width, size_t max_height, double character_ratio, size_t n_threads);
+
+void get_resized_dimensions(size_t width, size_t height, size_t max_width, size_t max_height, double character_ratio, size_t* out_width, size_t* out_height);
 image_t make_resized(image_t* original, size_t max_width, size_t max_height, double character_ratio);
+image_t make_resized_u8(image_u8_t* original, size_t max_width, size_t max_height, double character_ratio);
+image_t make_resampled_u8(image_u8_t* original, size_t width, size_t height, size_t n_threads);
 
 image_t make_grayscale(image_t* original);
+void get_grayscale(image_t* original, double* out);
 
 double* get_pixel(image_t* image, size_t x, size_t y);
 void set_pixel(image_t* image, size_t x, size_t y, const double* new_pixel);
 
 void get_convolution(image_t* image, double* kernel, double* out);
+void get_convolution_rows(image_t* image, double* kernel, double* out, size_t begin, size_t end);
 void get_sobel(image_t* image, double* out_x, double* out_y);
+void get_sobel_rows(image_t* image, double* out_x, double* out_y, size_t begin, size_t end);
 
 #endif
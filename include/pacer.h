@@ -0,0 +1,32 @@
+#ifndef MY_PACER
+#define MY_PACER
+#include <stdlib.h>
+
+// Paces an animation on a fixed grid of absolute deadlines, dropping the
+// slots it misses, and watches stdin for a key press while it waits.
+typedef struct {
+    double period;
+    double deadline;
+    double woke_at;
+    double last_shown;
+    int watch_stdin;
+
+    // Per-frame timings in seconds, kept for statistics on exit
+    double* intervals;
+    double* render_times;
+    size_t n_samples;
+    size_t capacity;
+    size_t n_frames;
+    size_t n_dropped;
+} pacer_t;
+
+double get_seconds(void);
+
+pacer_t make_pacer(double fps);
+void free_pacer(pacer_t* pacer);
+
+void pacer_frame_shown(pacer_t* pacer);
+int pacer_wait(pacer_t* pacer, char* key);
+void print_pacer_stats(pacer_t* pacer);
+
+#endif
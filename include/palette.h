@@ -0,0 +1,8 @@
+#ifndef MY_PALETTE
+#define MY_PALETTE
+#include "argparse.h"
+
+int get_palette_index(color_depth_t depth, int r, int g, int b);
+void get_palette_color(color_depth_t depth, int index, int* out_r, int* out_g, int* out_b);
+
+#endif
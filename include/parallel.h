@@ -0,0 +1,15 @@
+#ifndef MY_PARALLEL
+#define MY_PARALLEL
+#include <stdlib.h>
+
+// Work on rows [begin, end), the band'th of the bands run_bands splits into
+typedef void (*band_func_t)(void* context, size_t begin, size_t end, size_t band);
+
+// Runs job number `job` on the worker'th thread of run_jobs
+typedef void (*job_func_t)(void* context, size_t job, size_t worker);
+
+size_t get_band_count(size_t n_rows, size_t n_threads);
+void run_bands(size_t n_rows, size_t n_threads, band_func_t func, void* context);
+void run_jobs(size_t n_jobs, size_t n_threads, job_func_t func, void* context);
+
+#endif
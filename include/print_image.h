@@ -1,15 +1,41 @@
 #ifndef MY_PRINT_IMAGE
 #define MY_PRINT_IMAGE
 #include "image.h"
+#include "color.h"
+#include "argparse.h"
+#include "frame.h"
+#include "arena.h"
 
+// Memory kept from one render to the next: planes such as the luminance, and
+// each band's row buffers and frame. After the first of a run of images or
+// frames of the same size, rendering allocates nothing. Zeroed when unused;
+// functions taking one also accept NULL to allocate for that call alone.
 typedef struct {
-    double hue;
-    double saturation;
-    double value;
-} hsv_t;
-
-void print_image(image_t* image, double edge_threshold, int use_retro_colors);
-void print_rainbow_image(image_t* image, double edge_threshold, int use_retro_colors);
-void get_ascii_and_color(char* ascii_dest, hsv_t* hsv_dest, image_t* image, double edge_threshold, int use_retro_colors);
+    arena_t planes;
+    arena_t* band_arenas;
+    frame_t* band_frames;
+    size_t n_bands;
+    size_t n_allocations; // Of the band arrays and frames; arenas count their own
+    size_t n_renders;
+    size_t first_allocations; // Everything allocated by the end of the first render
+} render_scratch_t;
+
+void free_render_scratch(render_scratch_t* scratch);
+void print_scratch_stats(const render_scratch_t* scratches, size_t n_scratches);
+
+int print_image(image_t* image, const args_t* args, render_scratch_t* scratch);
+size_t get_cell_rows(const image_t* image, const args_t* args);
+void render_image(image_t* image, const args_t* args, frame_t* frame, render_scratch_t* scratch);
+void render_document(image_t* image, const args_t* args, frame_t* frame, render_scratch_t* scratch);
+void print_rainbow_image(image_t* image, const args_t* args);
+void print_output_stats(size_t total_bytes, size_t saved_bytes, size_t n_frames);
+#ifndef _WIN32
+void set_raw_mode(void);
+void restore_mode(void);
+#endif
+char get_sobel_angle_char(double sobel_angle);
+char get_sobel_edge_char(double sx, double sy);
+void get_edge_chars(image_t* grayscale, size_t y, double edge_threshold, char* out);
+void get_ascii_and_color(char* ascii_dest, double* hue_dest, double* saturation_dest, image_t* image, double edge_threshold, int use_retro_colors);
 
 #endif
@@ -0,0 +1,25 @@
+#ifndef MY_RENDER_CACHE
+#define MY_RENDER_CACHE
+#include <stdlib.h>
+#include <stdint.h>
+#include "argparse.h"
+#include "frame.h"
+#include "print_image.h"
+
+// Identifies one rendering: the input file's bytes and every setting that
+// changes the output. Entries are stored as <content>-<settings> in hex.
+typedef struct {
+    uint64_t content_hash;
+    uint64_t settings_hash;
+} cache_key_t;
+
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
+cache_key_t make_cache_key(const unsigned char* data, size_t length, const args_t* args);
+
+int send_cached(const args_t* args, cache_key_t key, int fd);
+void store_cached(const args_t* args, cache_key_t key, const frame_t* frame);
+
+int render_file_cached(const char* file_path, const args_t* args, frame_t* frame, render_scratch_t* scratch,
+                       int fd, int* was_cached);
+
+#endif
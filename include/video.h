@@ -0,0 +1,8 @@
+#ifndef MY_VIDEO
+#define MY_VIDEO
+#include "argparse.h"
+
+int is_video(const char* file_path);
+int play_video(const args_t* args);
+
+#endif
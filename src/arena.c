@@ -0,0 +1,70 @@
+#include "../include/arena.h"
+
+// Enough for doubles and unaligned SIMD loads
+#define ARENA_ALIGNMENT 16
+
+struct arena_block {
+    arena_block_t* next;
+    // Keeps the memory after the header aligned
+    unsigned char padding[ARENA_ALIGNMENT - sizeof(arena_block_t*) % ARENA_ALIGNMENT];
+};
+
+
+// Returns uninitialized memory that stays valid until the next reset, or
+// NULL if out of memory
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+    void* memory;
+    if (arena->used + size <= arena->capacity) {
+        memory = arena->data + arena->used;
+        arena->used += size;
+    } else {
+        arena_block_t* block = malloc(sizeof(*block) + size);
+        if (!block)
+            return NULL;
+        arena->n_allocations++;
+        block->next = arena->overflow;
+        arena->overflow = block;
+        arena->overflow_bytes += size;
+        memory = block + 1;
+    }
+
+    size_t total = arena->used + arena->overflow_bytes;
+    if (total > arena->peak)
+        arena->peak = total;
+    return memory;
+}
+
+
+static void free_overflow(arena_t* arena) {
+    while (arena->overflow) {
+        arena_block_t* next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+    arena->overflow_bytes = 0;
+}
+
+
+// Frees everything allocated so far. If that didn't fit, the memory is
+// replaced with a single block big enough for all of it.
+void reset_arena(arena_t* arena) {
+    free_overflow(arena);
+    arena->used = 0;
+
+    if (arena->peak > arena->capacity) {
+        free(arena->data);
+        arena->data = malloc(arena->peak);
+        arena->capacity = arena->data ? arena->peak : 0;
+        arena->n_allocations += arena->data != NULL;
+    }
+}
+
+
+void free_arena(arena_t* arena) {
+    free_overflow(arena);
+    free(arena->data);
+    arena->data = NULL;
+    arena->capacity = arena->used = 0;
+}
@@ -16,14 +16,17 @@
 #define DEFAULT_MAX_HEIGHT 48
 #define DEFAULT_CHARACTER_RATIO 2.0
 #define DEFAULT_EDGE_THRESHOLD 4.0
+#define DEFAULT_CACHE_SIZE 256
 
 
 void print_help(char* exec_alias) {
     printf("USAGE:\n");
-    printf("\t%s <path/to/image> [OPTIONS]\n\n", exec_alias);
+    printf("\t%s <path/to/image> [OPTIONS]\n", exec_alias);
+    printf("\t%s <paths...> --batch <output/dir> [OPTIONS]\n\n", exec_alias);
 
     printf("ARGUMENTS:\n");
-    printf("\t<path/to/image>\t\tPath to image file\n\n");
+    printf("\t<path/to/image>\t\tPath to image file, or - to read from stdin\n");
+    printf("\t<paths...>\t\tImages, directories of images, or @file with one path per line\n\n");
 
     printf("OPTIONS:\n");
     printf("\t-mw <width>\t\tMaximum width in characters (default: terminal width OR %d)\n", DEFAULT_MAX_WIDTH);
@@ -31,9 +34,47 @@ void print_help(char* exec_alias) {
     printf("\t-et <threshold>\t\tEdge detection threshold, range: 0.0 - 4.0 (default: %.1f, disabled)\n", DEFAULT_EDGE_THRESHOLD);
     printf("\t-cr <ratio>\t\tHeight-to-width ratio for characters (default: %.1f)\n", DEFAULT_CHARACTER_RATIO);
     printf("\t--retro-colors\t\tUse 3-bit retro color palette (8 colors) instead of 24-bit truecolor\n");
+    printf("\t--256-colors\t\tSend colors from the xterm 256-color palette (38;5;N) instead of 24-bit\n");
+    printf("\t--16-colors\t\tSend colors from the basic 16-color palette (30-37, 90-97) instead of 24-bit\n");
+    printf("\t--half-blocks\t\tDraw two pixels per character with colored half blocks instead of ascii\n");
+    printf("\t--braille\t\tDraw a 2x4 grid of dots per character with Braille patterns instead of ascii\n");
+    printf("\t--shapes\t\tPick the ascii character whose shape best matches each 4x8 block of pixels\n");
     printf("\t-r\t\t\tAnimate ascii art with rainbow by shifting colors (q or Q to quit)\n");
+    printf("\t--full-redraw\t\tRedraw every cell of each rainbow frame instead of only changed ones\n");
+    printf("\t--fps <rate>\t\tFrames per second for animations (default: 20, or 1 with --retro-colors)\n");
+    printf("\t-j <threads>\t\tNumber of threads to render with (default: 1)\n");
+    printf("\t--stream\t\tRead images from stdin, each one preceded by its length as a 4-byte big-endian integer\n");
+    printf("\t-o <file>\t\tWrite to a .ansi, .txt (glyphs only) or .html file instead of stdout\n");
+    printf("\t--batch <dir>\t\tRender every input to its own file in this directory, using -j workers;\n");
+    printf("\t\t\t\tthe extension of -o picks the format (default: .ansi)\n");
+    printf("\t--cache\t\t\tReuse earlier renderings of the same image and settings from disk\n");
+    printf("\t--cache-dir <dir>\tCache directory, implies --cache (default: ~/.cache/ascii-view)\n");
+    printf("\t--cache-size <MiB>\tEvict least recently used renderings above this size (default: %d)\n", DEFAULT_CACHE_SIZE);
+    printf("\t--stats\t\t\tPrint output size statistics to stderr\n");
 }
 
+const char* get_output_extension(output_format_t format) {
+    switch (format) {
+        case OUTPUT_TEXT: return ".txt";
+        case OUTPUT_HTML: return ".html";
+        default: return ".ansi";
+    }
+}
+
+
+// Picks the output format from the file extension, defaulting to ANSI
+output_format_t get_output_format(const char* path) {
+    const char* extension = strrchr(path, '.');
+    if (extension && !strcmp(extension, ".txt"))
+        return OUTPUT_TEXT;
+    if (extension && (!strcmp(extension, ".html") || !strcmp(extension, ".htm")))
+        return OUTPUT_HTML;
+    if (!extension || strcmp(extension, ".ansi"))
+        fprintf(stderr, "Warning: Unknown output extension in '%s', writing ANSI\n", path);
+    return OUTPUT_ANSI;
+}
+
+
 // Get size of terminal in characters. Returns 1 if successful.
 int try_get_terminal_size(size_t* width, size_t* height) {
 #ifdef _WIN32
@@ -70,12 +111,27 @@ args_t parse_args(int argc, char* argv[]) {
     // Get variable defaults
     args_t args = {
         .file_path = NULL,
+        .input_paths = NULL,
+        .n_inputs = 0,
+        .batch_dir = NULL,
+        .output_path = NULL,
+        .output_format = OUTPUT_ANSI,
         .max_width = DEFAULT_MAX_WIDTH,
         .max_height = DEFAULT_MAX_HEIGHT,
         .character_ratio = DEFAULT_CHARACTER_RATIO,
         .edge_threshold = DEFAULT_EDGE_THRESHOLD,
         .use_retro_colors = 0,
-        .use_rainbow_colors = 0
+        .color_depth = COLORS_TRUECOLOR,
+        .render_mode = RENDER_ASCII,
+        .use_rainbow_colors = 0,
+        .use_full_redraw = 0,
+        .fps = 0.0,
+        .print_stats = 0,
+        .use_stream = 0,
+        .use_cache = 0,
+        .cache_dir = NULL,
+        .cache_size = DEFAULT_CACHE_SIZE,
+        .n_threads = 1
     };
 
     try_get_terminal_size(&args.max_width, &args.max_height);
@@ -94,6 +150,11 @@ args_t parse_args(int argc, char* argv[]) {
         args.file_path = argv[1];
     }
 
+    // Every path given, for batch mode
+    args.input_paths = malloc(sizeof(char*) * (size_t) argc);
+    if (args.input_paths)
+        args.input_paths[args.n_inputs++] = argv[1];
+
     // Get optional parameters
     for (size_t i = 2; i < (size_t) argc; i++) {
         if (!strcmp(argv[i], "-mw") && i + 1 < (size_t) argc)
@@ -104,13 +165,88 @@ args_t parse_args(int argc, char* argv[]) {
             args.edge_threshold = atof(argv[++i]);
         else if (!strcmp(argv[i], "-cr") && i + 1 < (size_t) argc)
             args.character_ratio = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--fps") && i + 1 < (size_t) argc)
+            args.fps = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < (size_t) argc)
+            args.n_threads = (size_t) atoi(argv[++i]);
         else if (!strcmp(argv[i], "--retro-colors"))
             args.use_retro_colors = 1;
+        else if (!strcmp(argv[i], "--256-colors"))
+            args.color_depth = COLORS_256;
+        else if (!strcmp(argv[i], "--16-colors"))
+            args.color_depth = COLORS_16;
+        else if (!strcmp(argv[i], "--half-blocks"))
+            args.render_mode = RENDER_HALF_BLOCKS;
+        else if (!strcmp(argv[i], "--braille"))
+            args.render_mode = RENDER_BRAILLE;
+        else if (!strcmp(argv[i], "--shapes"))
+            args.render_mode = RENDER_SHAPES;
         else if (!strcmp(argv[i], "--rainbow"))
             args.use_rainbow_colors = 1;
+        else if (!strcmp(argv[i], "--full-redraw"))
+            args.use_full_redraw = 1;
+        else if (!strcmp(argv[i], "--stream"))
+            args.use_stream = 1;
+        else if (!strcmp(argv[i], "-o") && i + 1 < (size_t) argc) {
+            args.output_path = argv[++i];
+            args.output_format = get_output_format(args.output_path);
+        } else if (!strcmp(argv[i], "--batch") && i + 1 < (size_t) argc)
+            args.batch_dir = argv[++i];
+        else if (!strcmp(argv[i], "--cache"))
+            args.use_cache = 1;
+        else if (!strcmp(argv[i], "--cache-dir") && i + 1 < (size_t) argc) {
+            args.cache_dir = argv[++i];
+            args.use_cache = 1;
+        } else if (!strcmp(argv[i], "--cache-size") && i + 1 < (size_t) argc)
+            args.cache_size = (size_t) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stats"))
+            args.print_stats = 1;
+        else if (argv[i][0] != '-' && args.input_paths)
+            args.input_paths[args.n_inputs++] = argv[i];
         else
             fprintf(stderr, "Warning: Ignoring invalid or incomplete argument '%s'\n", argv[i]);
     }
 
+    // The rainbow animation shifts the colors of ascii characters
+    if (args.render_mode != RENDER_ASCII && args.use_rainbow_colors) {
+        const char* mode_flags[] = {"", "--half-blocks", "--braille", "--shapes"};
+        fprintf(stderr, "Warning: Ignoring %s, the rainbow animation draws ascii characters\n",
+            mode_flags[args.render_mode]);
+        args.render_mode = RENDER_ASCII;
+    }
+
+    // Plain text has no colors, and half blocks draw nothing but colors
+    if (args.render_mode == RENDER_HALF_BLOCKS && args.output_format == OUTPUT_TEXT) {
+        fprintf(stderr, "Warning: Ignoring --half-blocks, plain text output has no colors to draw them with\n");
+        args.render_mode = RENDER_ASCII;
+    }
+
+    // Retro colors are shown at full brightness and leave the brightness to
+    // the characters, which half blocks don't have
+    if (args.render_mode == RENDER_HALF_BLOCKS && args.use_retro_colors) {
+        fprintf(stderr, "Warning: Ignoring --retro-colors, half blocks show brightness through their colors\n");
+        args.use_retro_colors = 0;
+    }
+
+    // Half blocks split each character into two square-ish pixels
+    if (args.render_mode == RENDER_HALF_BLOCKS) {
+        args.max_height *= 2;
+        args.character_ratio /= 2.0;
+    }
+
+    // Braille packs 2x4 dots into each character
+    if (args.render_mode == RENDER_BRAILLE) {
+        args.max_width *= 2;
+        args.max_height *= 4;
+        args.character_ratio /= 2.0;
+    }
+
+    // Shapes are matched on 4x8 samples of each character
+    if (args.render_mode == RENDER_SHAPES) {
+        args.max_width *= 4;
+        args.max_height *= 8;
+        args.character_ratio /= 2.0;
+    }
+
     return args;
 }
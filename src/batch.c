@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <io.h>
+    #include <direct.h>
+    #define open _open
+    #define close _close
+    #define make_directory(path) _mkdir(path)
+#else
+    #include <unistd.h>
+    #define make_directory(path) mkdir(path, 0755)
+#endif
+
+#include "../include/image.h"
+#include "../include/frame.h"
+#include "../include/parallel.h"
+#include "../include/print_image.h"
+#include "../include/batch.h"
+#include "../include/render_cache.h"
+#include "../include/pacer.h"
+
+typedef struct {
+    char** paths;
+    size_t n_paths;
+    size_t capacity;
+} path_list_t;
+
+typedef struct {
+    args_t args;
+    path_list_t* inputs;
+    char** output_names;
+    frame_t* frames;
+    render_scratch_t* scratches;
+    size_t* n_failed;
+    size_t* n_cached;
+} batch_t;
+
+
+static void add_path(path_list_t* list, const char* path) {
+    if (list->n_paths == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        char** paths = realloc(list->paths, sizeof(char*) * capacity);
+        if (!paths) {
+            fprintf(stderr, "Error: Failed to allocate memory for batch inputs!\n");
+            return;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    char* copy = malloc(strlen(path) + 1);
+    if (copy) {
+        strcpy(copy, path);
+        list->paths[list->n_paths++] = copy;
+    }
+}
+
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+// Adds every regular, non-hidden file in a directory, in name order
+static void add_directory(path_list_t* list, const char* dir_path) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "Error: Failed to open directory '%s'!\n", dir_path);
+        return;
+    }
+
+    size_t first = list->n_paths;
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        size_t length = strlen(dir_path) + strlen(entry->d_name) + 2;
+        char* path = malloc(length);
+        if (!path)
+            continue;
+        snprintf(path, length, "%s/%s", dir_path, entry->d_name);
+
+        struct stat info;
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode))
+            add_path(list, path);
+        free(path);
+    }
+    closedir(dir);
+
+    qsort(list->paths + first, list->n_paths - first, sizeof(char*), compare_paths);
+}
+
+
+// Adds one path per line of a list file, skipping blank lines
+static void add_list_file(path_list_t* list, const char* list_path) {
+    FILE* file = fopen(list_path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open list file '%s'!\n", list_path);
+        return;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0])
+            add_path(list, line);
+    }
+    fclose(file);
+}
+
+
+// An input is an image, a directory of images, or "@file" listing paths
+static void add_input(path_list_t* list, const char* input) {
+    struct stat info;
+    if (input[0] == '@')
+        add_list_file(list, input + 1);
+    else if (stat(input, &info) == 0 && S_ISDIR(info.st_mode))
+        add_directory(list, input);
+    else
+        add_path(list, input);
+}
+
+
+// Input file name without its directory and extension
+static char* get_base_name(const char* input) {
+    const char* name = input;
+    for (const char* c = input; *c; c++) {
+        if (*c == '/' || *c == '\\')
+            name = c + 1;
+    }
+    const char* extension = strrchr(name, '.');
+    size_t name_length = extension && extension != name ? (size_t) (extension - name) : strlen(name);
+
+    char* base_name = malloc(name_length + 1);
+    if (base_name) {
+        memcpy(base_name, name, name_length);
+        base_name[name_length] = '\0';
+    }
+    return base_name;
+}
+
+
+typedef struct {
+    const char* name;
+    size_t index;
+} named_input_t;
+
+
+static int compare_named_inputs(const void* a, const void* b) {
+    const named_input_t* first = a;
+    const named_input_t* second = b;
+    int order = strcmp(first->name, second->name);
+    if (order)
+        return order;
+    return (first->index > second->index) - (first->index < second->index);
+}
+
+
+static int compare_names(const void* key, const void* element) {
+    return strcmp(key, ((const named_input_t*) element)->name);
+}
+
+
+// Picks each input's output name: its base name, or for inputs that share
+// one, like a/pic.jpg and b/pic.png, the base name with a "-2", "-3", ...
+// suffix that no other input uses. The first input in order keeps the plain
+// name. Returns NULL if out of memory.
+static char** get_output_names(const path_list_t* inputs) {
+    size_t n = inputs->n_paths;
+    char** names = calloc(n ? n : 1, sizeof(char*));
+    named_input_t* sorted = malloc(sizeof(named_input_t) * (n ? n : 1));
+    path_list_t renamed = {0};
+    int failed = !names || !sorted;
+
+    for (size_t i = 0; i < n && !failed; i++) {
+        names[i] = get_base_name(inputs->paths[i]);
+        failed = !names[i];
+        if (!failed)
+            sorted[i] = (named_input_t) {names[i], i};
+    }
+    int is_sorted = !failed;
+    if (is_sorted)
+        qsort(sorted, n, sizeof(named_input_t), compare_named_inputs);
+
+    for (size_t i = 1; i < n && !failed; i++) {
+        if (strcmp(sorted[i].name, sorted[i - 1].name))
+            continue;
+
+        // A suffixed name must not be any input's own name, nor one given out before
+        size_t length = strlen(sorted[i].name) + 24;
+        char* name = malloc(length);
+        if (!name) {
+            failed = 1;
+            break;
+        }
+        for (size_t suffix = 2;; suffix++) {
+            snprintf(name, length, "%s-%zu", sorted[i].name, suffix);
+            int is_taken = bsearch(name, sorted, n, sizeof(named_input_t), compare_names) != NULL;
+            for (size_t k = 0; k < renamed.n_paths && !is_taken; k++)
+                is_taken = !strcmp(name, renamed.paths[k]);
+            if (!is_taken)
+                break;
+        }
+        add_path(&renamed, name);
+        names[sorted[i].index] = name;
+    }
+
+    // Replaced base names are freed only now, as the sorted list points at them
+    for (size_t i = 1; i < n && is_sorted; i++) {
+        if (names[sorted[i].index] != sorted[i].name)
+            free((char*) sorted[i].name);
+    }
+    for (size_t i = 0; i < renamed.n_paths; i++)
+        free(renamed.paths[i]);
+    free(renamed.paths);
+    free(sorted);
+
+    if (failed && names) {
+        for (size_t i = 0; i < n; i++)
+            free(names[i]);
+        free(names);
+        names = NULL;
+    }
+    return names;
+}
+
+
+// Output goes to <dir>/<output name>.<format extension>
+static char* get_output_path(const char* dir_path, const char* name, output_format_t format) {
+    const char* output_extension = get_output_extension(format);
+    size_t length = strlen(dir_path) + strlen(name) + strlen(output_extension) + 2;
+    char* path = malloc(length);
+    if (path)
+        snprintf(path, length, "%s/%s%s", dir_path, name, output_extension);
+    return path;
+}
+
+
+// Loads, resizes and renders one image and writes it to its output file
+static void render_job(void* context, size_t job, size_t worker) {
+    batch_t* batch = context;
+    const args_t* args = &batch->args;
+    const char* input = batch->inputs->paths[job];
+    frame_t* frame = &batch->frames[worker];
+    render_scratch_t* scratch = &batch->scratches[worker];
+
+    char* output_path = get_output_path(args->batch_dir, batch->output_names[job], args->output_format);
+    int fd = output_path ? open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open output file '%s'!\n", output_path ? output_path : input);
+        batch->n_failed[worker]++;
+        free(output_path);
+        return;
+    }
+    free(output_path);
+
+    if (args->use_cache) {
+        int was_cached;
+        if (!render_file_cached(input, args, frame, scratch, fd, &was_cached))
+            batch->n_failed[worker]++;
+        batch->n_cached[worker] += (size_t) was_cached;
+        close(fd);
+        return;
+    }
+
+    image_t resized = load_resized(input, args->max_width, args->max_height, args->character_ratio, 1);
+    if (resized.data) {
+        clear_frame(frame);
+        render_document(&resized, args, frame, scratch);
+        free_image(&resized);
+        if (!write_frame(frame, fd))
+            batch->n_failed[worker]++;
+    } else {
+        batch->n_failed[worker]++;
+    }
+    close(fd);
+}
+
+
+// Renders every input to its own file in args->batch_dir, spreading the
+// images over a pool of -j workers. Returns 1 if all of them succeeded.
+int run_batch(const args_t* args) {
+    path_list_t inputs = {0};
+    for (size_t i = 0; i < args->n_inputs; i++)
+        add_input(&inputs, args->input_paths[i]);
+
+    make_directory(args->batch_dir);
+
+    // Each worker renders whole images, so the rendering itself is single-threaded.
+    // Workers keep their frame and scratch memory from one image to the next.
+    size_t n_workers = get_band_count(inputs.n_paths, args->n_threads);
+    batch_t batch = {
+        .args = *args,
+        .inputs = &inputs,
+        .output_names = get_output_names(&inputs),
+        .frames = calloc(n_workers, sizeof(frame_t)),
+        .scratches = calloc(n_workers, sizeof(render_scratch_t)),
+        .n_failed = calloc(n_workers, sizeof(size_t)),
+        .n_cached = calloc(n_workers, sizeof(size_t))
+    };
+    batch.args.n_threads = 1;
+    batch.args.print_stats = 0;
+
+    size_t n_failed = 0, n_cached = 0;
+    double start = get_seconds();
+    if (batch.output_names && batch.frames && batch.scratches && batch.n_failed && batch.n_cached) {
+        run_jobs(inputs.n_paths, n_workers, render_job, &batch);
+        for (size_t w = 0; w < n_workers; w++) {
+            n_failed += batch.n_failed[w];
+            n_cached += batch.n_cached[w];
+        }
+    } else {
+        fprintf(stderr, "Error: Failed to allocate memory for batch workers!\n");
+        n_failed = inputs.n_paths;
+    }
+    double seconds = get_seconds() - start;
+
+    fprintf(stderr, "Batch: %zu images in %.2f s (%.1f images/s) with %zu workers, %zu failed",
+        inputs.n_paths, seconds, seconds > 0.0 ? inputs.n_paths / seconds : 0.0, n_workers, n_failed);
+    if (args->use_cache)
+        fprintf(stderr, ", %zu from cache", n_cached);
+    fprintf(stderr, "\n");
+    if (args->print_stats && batch.scratches)
+        print_scratch_stats(batch.scratches, n_workers);
+
+    for (size_t w = 0; w < n_workers; w++) {
+        if (batch.frames)
+            free_frame(&batch.frames[w]);
+        if (batch.scratches)
+            free_render_scratch(&batch.scratches[w]);
+    }
+    for (size_t i = 0; i < inputs.n_paths; i++) {
+        free(inputs.paths[i]);
+        if (batch.output_names)
+            free(batch.output_names[i]);
+    }
+    free(batch.output_names);
+    free(inputs.paths);
+    free(batch.frames);
+    free(batch.scratches);
+    free(batch.n_failed);
+    free(batch.n_cached);
+
+    return n_failed == 0;
+}
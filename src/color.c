@@ -0,0 +1,575 @@
+#include <math.h>
+
+#include "../include/color.h"
+
+// SIMD kernels need GCC/Clang target attributes on x86
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define COLOR_SIMD 1
+#endif
+
+
+double* get_max(double* a, double* b, double* c) {
+    if ((*a >= *b) && (*a >= *c)) {
+        return a;
+    } else if (*b >= *c) {
+        return b;
+    } else {
+        return c;
+    }
+}
+
+double* get_min(double* a, double* b, double* c) {
+    if ((*a <= *b) && (*a <= *c)) {
+        return a;
+    } else if (*b <= *c) {
+        return b;
+    } else {
+        return c;
+    }
+}
+
+
+hsv_t rgb_to_hsv(double red, double green, double blue) {
+    hsv_t hsv;
+
+    double* max = get_max(&red, &green, &blue);
+    double* min = get_min(&red, &green, &blue);
+
+    hsv.value = *max;
+    double chroma = hsv.value - *min;
+
+    // Calculate saturation
+    if (fabs(hsv.value) < 1e-4) {
+        hsv.saturation = 0.0;
+    } else {
+        hsv.saturation = chroma / hsv.value;
+    }
+
+    // Calculate hue
+    if (chroma < 1e-4) {
+        hsv.hue = 0.0;
+    } else if (max == &red) {
+        hsv.hue = 60.0 * fmod((green - blue) / chroma, 6.0);
+        if (hsv.hue < 0.0) hsv.hue += 360.0;
+    } else if (max == &green) {
+        hsv.hue = 60.0 * (2.0 + (blue - red) / chroma);
+    } else {
+        hsv.hue = 60.0 * (4.0 + (red - green) / chroma);
+    }
+
+    return hsv;
+}
+
+
+void hsv_to_rgb(const hsv_t* hsv, double* r, double* g, double* b) {
+    double c = hsv->value * hsv->saturation;
+    double h_prime = hsv->hue / 60.0;
+    double x = c * (1.0 - fabs(fmod(h_prime, 2.0) - 1.0));
+
+    double r1, g1, b1;
+
+    if (h_prime >= 0.0 && h_prime < 1.0) {
+        r1 = c; g1 = x; b1 = 0.0;
+    } else if (h_prime >= 1.0 && h_prime < 2.0) {
+        r1 = x; g1 = c; b1 = 0.0;
+    } else if (h_prime >= 2.0 && h_prime < 3.0) {
+        r1 = 0.0; g1 = c; b1 = x;
+    } else if (h_prime >= 3.0 && h_prime < 4.0) {
+        r1 = 0.0; g1 = x; b1 = c;
+    } else if (h_prime >= 4.0 && h_prime < 5.0) {
+        r1 = x; g1 = 0.0; b1 = c;
+    } else {
+        r1 = c; g1 = 0.0; b1 = x;
+    }
+
+    double m = hsv->value - c;
+    *r = r1 + m;
+    *g = g1 + m;
+    *b = b1 + m;
+}
+
+
+// Best instruction set this CPU supports
+color_isa_t get_color_isa(void) {
+#ifdef COLOR_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return COLOR_ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return COLOR_ISA_SSE4;
+#endif
+    return COLOR_ISA_SCALAR;
+}
+
+
+const char* get_color_isa_name(color_isa_t isa) {
+    switch (isa) {
+        case COLOR_ISA_AVX2: return "avx2";
+        case COLOR_ISA_SSE4: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+
+// The SIMD kernels below do the same IEEE operations as rgb_to_hsv and
+// hsv_to_rgb, lane by lane, so their results are bit-identical. Branches
+// become masks: fmod(x, 6) is x itself for the |x| <= 1 it is given, and
+// fmod(h, 2) is h - 2 * trunc(h / 2), which is exact. The lane math is shared
+// by the kernels for hsv_t rows and for planar rows, which only load and
+// store differently.
+#ifdef COLOR_SIMD
+
+__attribute__((target("avx2")))
+static inline void rgb_to_hsv_lanes_avx2(__m256d r, __m256d g, __m256d b, __m256d* out_h, __m256d* out_s, __m256d* out_v) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d epsilon = _mm256_set1_pd(1e-4);
+    const __m256d sixty = _mm256_set1_pd(60.0);
+    const __m256d full_turn = _mm256_set1_pd(360.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+
+    // Same tie-breaking as get_max: red, then green, then blue
+    __m256d red_max = _mm256_and_pd(_mm256_cmp_pd(r, g, _CMP_GE_OQ), _mm256_cmp_pd(r, b, _CMP_GE_OQ));
+    __m256d green_max = _mm256_andnot_pd(red_max, _mm256_cmp_pd(g, b, _CMP_GE_OQ));
+    __m256d max = _mm256_blendv_pd(_mm256_blendv_pd(b, g, green_max), r, red_max);
+    __m256d min = _mm256_min_pd(r, _mm256_min_pd(g, b));
+
+    __m256d value = max;
+    __m256d chroma = _mm256_sub_pd(value, min);
+
+    __m256d dark = _mm256_cmp_pd(_mm256_andnot_pd(sign, value), epsilon, _CMP_LT_OQ);
+    __m256d saturation = _mm256_blendv_pd(_mm256_div_pd(chroma, value), zero, dark);
+
+    __m256d red_hue = _mm256_mul_pd(sixty, _mm256_div_pd(_mm256_sub_pd(g, b), chroma));
+    red_hue = _mm256_add_pd(red_hue, _mm256_and_pd(_mm256_cmp_pd(red_hue, zero, _CMP_LT_OQ), full_turn));
+    __m256d green_hue = _mm256_mul_pd(sixty, _mm256_add_pd(two, _mm256_div_pd(_mm256_sub_pd(b, r), chroma)));
+    __m256d blue_hue = _mm256_mul_pd(sixty, _mm256_add_pd(four, _mm256_div_pd(_mm256_sub_pd(r, g), chroma)));
+
+    __m256d hue = _mm256_blendv_pd(_mm256_blendv_pd(blue_hue, green_hue, green_max), red_hue, red_max);
+    *out_h = _mm256_blendv_pd(hue, zero, _mm256_cmp_pd(chroma, epsilon, _CMP_LT_OQ));
+    *out_s = saturation;
+    *out_v = value;
+}
+
+
+__attribute__((target("avx2")))
+static inline void hsv_to_rgb_lanes_avx2(__m256d h, __m256d s, __m256d v, __m256d* out_r, __m256d* out_g, __m256d* out_b) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d sixty = _mm256_set1_pd(60.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+
+    __m256d c = _mm256_mul_pd(v, s);
+    __m256d h_prime = _mm256_div_pd(h, sixty);
+    __m256d h_mod = _mm256_sub_pd(h_prime, _mm256_mul_pd(two, _mm256_round_pd(_mm256_mul_pd(h_prime, half), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)));
+    __m256d x = _mm256_mul_pd(c, _mm256_sub_pd(one, _mm256_andnot_pd(sign, _mm256_sub_pd(h_mod, one))));
+
+    // Sextant masks; anything outside [0, 5) falls in the last one
+    __m256d sextants[5];
+    __m256d any = _mm256_setzero_pd();
+    for (int k = 0; k < 5; k++) {
+        sextants[k] = _mm256_and_pd(_mm256_cmp_pd(h_prime, _mm256_set1_pd(k), _CMP_GE_OQ), _mm256_cmp_pd(h_prime, _mm256_set1_pd(k + 1), _CMP_LT_OQ));
+        any = _mm256_or_pd(any, sextants[k]);
+    }
+    __m256d last = _mm256_andnot_pd(any, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+
+    __m256d r1 = _mm256_or_pd(_mm256_and_pd(_mm256_or_pd(sextants[0], last), c), _mm256_and_pd(_mm256_or_pd(sextants[1], sextants[4]), x));
+    __m256d g1 = _mm256_or_pd(_mm256_and_pd(_mm256_or_pd(sextants[1], sextants[2]), c), _mm256_and_pd(_mm256_or_pd(sextants[0], sextants[3]), x));
+    __m256d b1 = _mm256_or_pd(_mm256_and_pd(_mm256_or_pd(sextants[3], sextants[4]), c), _mm256_and_pd(_mm256_or_pd(sextants[2], last), x));
+
+    __m256d m = _mm256_sub_pd(v, c);
+    *out_r = _mm256_add_pd(r1, m);
+    *out_g = _mm256_add_pd(g1, m);
+    *out_b = _mm256_add_pd(b1, m);
+}
+
+
+// Spreads four lanes of each channel into packed RGB triples
+__attribute__((target("avx2")))
+static inline void store_rgb_avx2(double* out, __m256d r, __m256d g, __m256d b) {
+    double rs[4], gs[4], bs[4];
+    _mm256_storeu_pd(rs, r);
+    _mm256_storeu_pd(gs, g);
+    _mm256_storeu_pd(bs, b);
+    for (size_t k = 0; k < 4; k++) {
+        out[k * 3] = rs[k];
+        out[k * 3 + 1] = gs[k];
+        out[k * 3 + 2] = bs[k];
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void rgb_to_hsv_avx2(const double* pixels, size_t channels, hsv_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const double* p = &pixels[i * channels];
+        __m256d r = _mm256_set_pd(p[3 * channels], p[2 * channels], p[channels], p[0]);
+        __m256d g = _mm256_set_pd(p[3 * channels + 1], p[2 * channels + 1], p[channels + 1], p[1]);
+        __m256d b = _mm256_set_pd(p[3 * channels + 2], p[2 * channels + 2], p[channels + 2], p[2]);
+
+        __m256d hue, saturation, value;
+        rgb_to_hsv_lanes_avx2(r, g, b, &hue, &saturation, &value);
+
+        double hues[4], saturations[4], values[4];
+        _mm256_storeu_pd(hues, hue);
+        _mm256_storeu_pd(saturations, saturation);
+        _mm256_storeu_pd(values, value);
+        for (size_t k = 0; k < 4; k++) {
+            out[i + k] = (hsv_t) {hues[k], saturations[k], values[k]};
+        }
+    }
+
+    for (; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        out[i] = rgb_to_hsv(p[0], p[1], p[2]);
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void rgb_to_hsv_planes_avx2(const double* pixels, size_t channels, hsv_planes_t out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const double* p = &pixels[i * channels];
+        __m256d r = _mm256_set_pd(p[3 * channels], p[2 * channels], p[channels], p[0]);
+        __m256d g = _mm256_set_pd(p[3 * channels + 1], p[2 * channels + 1], p[channels + 1], p[1]);
+        __m256d b = _mm256_set_pd(p[3 * channels + 2], p[2 * channels + 2], p[channels + 2], p[2]);
+
+        __m256d hue, saturation, value;
+        rgb_to_hsv_lanes_avx2(r, g, b, &hue, &saturation, &value);
+        _mm256_storeu_pd(&out.hues[i], hue);
+        _mm256_storeu_pd(&out.saturations[i], saturation);
+        _mm256_storeu_pd(&out.values[i], value);
+    }
+
+    for (; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        hsv_t hsv = rgb_to_hsv(p[0], p[1], p[2]);
+        out.hues[i] = hsv.hue, out.saturations[i] = hsv.saturation, out.values[i] = hsv.value;
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void hsv_to_rgb_avx2(const hsv_t* hsvs, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const hsv_t* p = &hsvs[i];
+        __m256d h = _mm256_set_pd(p[3].hue, p[2].hue, p[1].hue, p[0].hue);
+        __m256d s = _mm256_set_pd(p[3].saturation, p[2].saturation, p[1].saturation, p[0].saturation);
+        __m256d v = _mm256_set_pd(p[3].value, p[2].value, p[1].value, p[0].value);
+
+        __m256d r, g, b;
+        hsv_to_rgb_lanes_avx2(h, s, v, &r, &g, &b);
+        store_rgb_avx2(&out[i * 3], r, g, b);
+    }
+
+    for (; i < n; i++) {
+        hsv_to_rgb(&hsvs[i], &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void hsv_to_rgb_planes_avx2(hsv_planes_t hsvs, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d r, g, b;
+        hsv_to_rgb_lanes_avx2(_mm256_loadu_pd(&hsvs.hues[i]), _mm256_loadu_pd(&hsvs.saturations[i]),
+            _mm256_loadu_pd(&hsvs.values[i]), &r, &g, &b);
+        store_rgb_avx2(&out[i * 3], r, g, b);
+    }
+
+    for (; i < n; i++) {
+        hsv_t hsv = {hsvs.hues[i], hsvs.saturations[i], hsvs.values[i]};
+        hsv_to_rgb(&hsv, &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+
+__attribute__((target("sse4.1")))
+static inline void rgb_to_hsv_lanes_sse4(__m128d r, __m128d g, __m128d b, __m128d* out_h, __m128d* out_s, __m128d* out_v) {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d epsilon = _mm_set1_pd(1e-4);
+    const __m128d sixty = _mm_set1_pd(60.0);
+    const __m128d full_turn = _mm_set1_pd(360.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d sign = _mm_set1_pd(-0.0);
+
+    // Same tie-breaking as get_max: red, then green, then blue
+    __m128d red_max = _mm_and_pd(_mm_cmpge_pd(r, g), _mm_cmpge_pd(r, b));
+    __m128d green_max = _mm_andnot_pd(red_max, _mm_cmpge_pd(g, b));
+    __m128d max = _mm_blendv_pd(_mm_blendv_pd(b, g, green_max), r, red_max);
+    __m128d min = _mm_min_pd(r, _mm_min_pd(g, b));
+
+    __m128d value = max;
+    __m128d chroma = _mm_sub_pd(value, min);
+
+    __m128d dark = _mm_cmplt_pd(_mm_andnot_pd(sign, value), epsilon);
+    __m128d saturation = _mm_blendv_pd(_mm_div_pd(chroma, value), zero, dark);
+
+    __m128d red_hue = _mm_mul_pd(sixty, _mm_div_pd(_mm_sub_pd(g, b), chroma));
+    red_hue = _mm_add_pd(red_hue, _mm_and_pd(_mm_cmplt_pd(red_hue, zero), full_turn));
+    __m128d green_hue = _mm_mul_pd(sixty, _mm_add_pd(two, _mm_div_pd(_mm_sub_pd(b, r), chroma)));
+    __m128d blue_hue = _mm_mul_pd(sixty, _mm_add_pd(four, _mm_div_pd(_mm_sub_pd(r, g), chroma)));
+
+    __m128d hue = _mm_blendv_pd(_mm_blendv_pd(blue_hue, green_hue, green_max), red_hue, red_max);
+    *out_h = _mm_blendv_pd(hue, zero, _mm_cmplt_pd(chroma, epsilon));
+    *out_s = saturation;
+    *out_v = value;
+}
+
+
+__attribute__((target("sse4.1")))
+static inline void hsv_to_rgb_lanes_sse4(__m128d h, __m128d s, __m128d v, __m128d* out_r, __m128d* out_g, __m128d* out_b) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d sixty = _mm_set1_pd(60.0);
+    const __m128d sign = _mm_set1_pd(-0.0);
+
+    __m128d c = _mm_mul_pd(v, s);
+    __m128d h_prime = _mm_div_pd(h, sixty);
+    __m128d h_mod = _mm_sub_pd(h_prime, _mm_mul_pd(two, _mm_round_pd(_mm_mul_pd(h_prime, half), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)));
+    __m128d x = _mm_mul_pd(c, _mm_sub_pd(one, _mm_andnot_pd(sign, _mm_sub_pd(h_mod, one))));
+
+    // Sextant masks; anything outside [0, 5) falls in the last one
+    __m128d sextants[5];
+    __m128d any = _mm_setzero_pd();
+    for (int k = 0; k < 5; k++) {
+        sextants[k] = _mm_and_pd(_mm_cmpge_pd(h_prime, _mm_set1_pd(k)), _mm_cmplt_pd(h_prime, _mm_set1_pd(k + 1)));
+        any = _mm_or_pd(any, sextants[k]);
+    }
+    __m128d last = _mm_andnot_pd(any, _mm_castsi128_pd(_mm_set1_epi64x(-1)));
+
+    __m128d r1 = _mm_or_pd(_mm_and_pd(_mm_or_pd(sextants[0], last), c), _mm_and_pd(_mm_or_pd(sextants[1], sextants[4]), x));
+    __m128d g1 = _mm_or_pd(_mm_and_pd(_mm_or_pd(sextants[1], sextants[2]), c), _mm_and_pd(_mm_or_pd(sextants[0], sextants[3]), x));
+    __m128d b1 = _mm_or_pd(_mm_and_pd(_mm_or_pd(sextants[3], sextants[4]), c), _mm_and_pd(_mm_or_pd(sextants[2], last), x));
+
+    __m128d m = _mm_sub_pd(v, c);
+    *out_r = _mm_add_pd(r1, m);
+    *out_g = _mm_add_pd(g1, m);
+    *out_b = _mm_add_pd(b1, m);
+}
+
+
+__attribute__((target("sse4.1")))
+static inline void store_rgb_sse4(double* out, __m128d r, __m128d g, __m128d b) {
+    double rs[2], gs[2], bs[2];
+    _mm_storeu_pd(rs, r);
+    _mm_storeu_pd(gs, g);
+    _mm_storeu_pd(bs, b);
+    for (size_t k = 0; k < 2; k++) {
+        out[k * 3] = rs[k];
+        out[k * 3 + 1] = gs[k];
+        out[k * 3 + 2] = bs[k];
+    }
+}
+
+
+__attribute__((target("sse4.1")))
+static void rgb_to_hsv_sse4(const double* pixels, size_t channels, hsv_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const double* p = &pixels[i * channels];
+        __m128d r = _mm_set_pd(p[channels], p[0]);
+        __m128d g = _mm_set_pd(p[channels + 1], p[1]);
+        __m128d b = _mm_set_pd(p[channels + 2], p[2]);
+
+        __m128d hue, saturation, value;
+        rgb_to_hsv_lanes_sse4(r, g, b, &hue, &saturation, &value);
+
+        double hues[2], saturations[2], values[2];
+        _mm_storeu_pd(hues, hue);
+        _mm_storeu_pd(saturations, saturation);
+        _mm_storeu_pd(values, value);
+        for (size_t k = 0; k < 2; k++) {
+            out[i + k] = (hsv_t) {hues[k], saturations[k], values[k]};
+        }
+    }
+
+    for (; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        out[i] = rgb_to_hsv(p[0], p[1], p[2]);
+    }
+}
+
+
+__attribute__((target("sse4.1")))
+static void rgb_to_hsv_planes_sse4(const double* pixels, size_t channels, hsv_planes_t out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const double* p = &pixels[i * channels];
+        __m128d r = _mm_set_pd(p[channels], p[0]);
+        __m128d g = _mm_set_pd(p[channels + 1], p[1]);
+        __m128d b = _mm_set_pd(p[channels + 2], p[2]);
+
+        __m128d hue, saturation, value;
+        rgb_to_hsv_lanes_sse4(r, g, b, &hue, &saturation, &value);
+        _mm_storeu_pd(&out.hues[i], hue);
+        _mm_storeu_pd(&out.saturations[i], saturation);
+        _mm_storeu_pd(&out.values[i], value);
+    }
+
+    for (; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        hsv_t hsv = rgb_to_hsv(p[0], p[1], p[2]);
+        out.hues[i] = hsv.hue, out.saturations[i] = hsv.saturation, out.values[i] = hsv.value;
+    }
+}
+
+
+__attribute__((target("sse4.1")))
+static void hsv_to_rgb_sse4(const hsv_t* hsvs, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const hsv_t* p = &hsvs[i];
+        __m128d h = _mm_set_pd(p[1].hue, p[0].hue);
+        __m128d s = _mm_set_pd(p[1].saturation, p[0].saturation);
+        __m128d v = _mm_set_pd(p[1].value, p[0].value);
+
+        __m128d r, g, b;
+        hsv_to_rgb_lanes_sse4(h, s, v, &r, &g, &b);
+        store_rgb_sse4(&out[i * 3], r, g, b);
+    }
+
+    for (; i < n; i++) {
+        hsv_to_rgb(&hsvs[i], &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+
+__attribute__((target("sse4.1")))
+static void hsv_to_rgb_planes_sse4(hsv_planes_t hsvs, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d r, g, b;
+        hsv_to_rgb_lanes_sse4(_mm_loadu_pd(&hsvs.hues[i]), _mm_loadu_pd(&hsvs.saturations[i]),
+            _mm_loadu_pd(&hsvs.values[i]), &r, &g, &b);
+        store_rgb_sse4(&out[i * 3], r, g, b);
+    }
+
+    for (; i < n; i++) {
+        hsv_t hsv = {hsvs.hues[i], hsvs.saturations[i], hsvs.values[i]};
+        hsv_to_rgb(&hsv, &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+#endif
+
+
+// Converts n pixels of an interleaved RGB(A) row to HSV on the given
+// instruction set, falling back to scalar code if it isn't available
+void rgb_to_hsv_row_isa(color_isa_t isa, const double* pixels, size_t channels, hsv_t* out, size_t n) {
+#ifdef COLOR_SIMD
+    if (isa > get_color_isa())
+        isa = get_color_isa();
+    if (isa == COLOR_ISA_AVX2) {
+        rgb_to_hsv_avx2(pixels, channels, out, n);
+        return;
+    }
+    if (isa == COLOR_ISA_SSE4) {
+        rgb_to_hsv_sse4(pixels, channels, out, n);
+        return;
+    }
+#else
+    (void) isa;
+#endif
+    for (size_t i = 0; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        out[i] = rgb_to_hsv(p[0], p[1], p[2]);
+    }
+}
+
+
+// Same as rgb_to_hsv_row_isa, writing each component to its own plane
+void rgb_to_hsv_planes_isa(color_isa_t isa, const double* pixels, size_t channels, hsv_planes_t out, size_t n) {
+#ifdef COLOR_SIMD
+    if (isa > get_color_isa())
+        isa = get_color_isa();
+    if (isa == COLOR_ISA_AVX2) {
+        rgb_to_hsv_planes_avx2(pixels, channels, out, n);
+        return;
+    }
+    if (isa == COLOR_ISA_SSE4) {
+        rgb_to_hsv_planes_sse4(pixels, channels, out, n);
+        return;
+    }
+#else
+    (void) isa;
+#endif
+    for (size_t i = 0; i < n; i++) {
+        const double* p = &pixels[i * channels];
+        hsv_t hsv = rgb_to_hsv(p[0], p[1], p[2]);
+        out.hues[i] = hsv.hue, out.saturations[i] = hsv.saturation, out.values[i] = hsv.value;
+    }
+}
+
+
+// Converts n HSV values to packed RGB triples on the given instruction set
+void hsv_to_rgb_row_isa(color_isa_t isa, const hsv_t* hsvs, double* out, size_t n) {
+#ifdef COLOR_SIMD
+    if (isa > get_color_isa())
+        isa = get_color_isa();
+    if (isa == COLOR_ISA_AVX2) {
+        hsv_to_rgb_avx2(hsvs, out, n);
+        return;
+    }
+    if (isa == COLOR_ISA_SSE4) {
+        hsv_to_rgb_sse4(hsvs, out, n);
+        return;
+    }
+#else
+    (void) isa;
+#endif
+    for (size_t i = 0; i < n; i++) {
+        hsv_to_rgb(&hsvs[i], &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+
+// Same as hsv_to_rgb_row_isa, reading each component from its own plane
+void hsv_to_rgb_planes_isa(color_isa_t isa, hsv_planes_t hsvs, double* out, size_t n) {
+#ifdef COLOR_SIMD
+    if (isa > get_color_isa())
+        isa = get_color_isa();
+    if (isa == COLOR_ISA_AVX2) {
+        hsv_to_rgb_planes_avx2(hsvs, out, n);
+        return;
+    }
+    if (isa == COLOR_ISA_SSE4) {
+        hsv_to_rgb_planes_sse4(hsvs, out, n);
+        return;
+    }
+#else
+    (void) isa;
+#endif
+    for (size_t i = 0; i < n; i++) {
+        hsv_t hsv = {hsvs.hues[i], hsvs.saturations[i], hsvs.values[i]};
+        hsv_to_rgb(&hsv, &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    }
+}
+
+
+void rgb_to_hsv_row(const double* pixels, size_t channels, hsv_t* out, size_t n) {
+    rgb_to_hsv_row_isa(get_color_isa(), pixels, channels, out, n);
+}
+
+
+void hsv_to_rgb_row(const hsv_t* hsvs, double* out, size_t n) {
+    hsv_to_rgb_row_isa(get_color_isa(), hsvs, out, n);
+}
+
+
+void rgb_to_hsv_planes(const double* pixels, size_t channels, hsv_planes_t out, size_t n) {
+    rgb_to_hsv_planes_isa(get_color_isa(), pixels, channels, out, n);
+}
+
+
+void hsv_to_rgb_planes(hsv_planes_t hsvs, double* out, size_t n) {
+    hsv_to_rgb_planes_isa(get_color_isa(), hsvs, out, n);
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "../include/file_map.h"
+
+
+// Reads whole file into memory through stdio. Returns NULL on failure.
+unsigned char* read_file(const char* file_path, size_t* length) {
+    FILE* file = fopen(file_path, "rb");
+    if (!file)
+        return NULL;
+
+    unsigned char* buffer = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+        size = ftell(file);
+
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        buffer = malloc((size_t) size);
+        if (buffer && fread(buffer, 1, (size_t) size, file) != (size_t) size) {
+            free(buffer);
+            buffer = NULL;
+        }
+    }
+
+    fclose(file);
+    *length = (size_t) size;
+    return buffer;
+}
+
+
+// Maps a whole file read-only, so the decoder reads straight from the page
+// cache without an extra copy. Falls back to reading it when the file can't
+// be mapped (e.g. a pipe). `data` is NULL on failure.
+file_map_t map_file(const char* file_path) {
+    file_map_t file = {0};
+
+#ifndef _WIN32
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+        return file;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // Decoders read front to back, so ask for aggressive read-ahead
+            madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+            file.data = data;
+            file.length = (size_t) info.st_size;
+            file.is_mapped = 1;
+        }
+    }
+    close(fd);
+
+    if (file.is_mapped)
+        return file;
+#endif
+
+    file.data = read_file(file_path, &file.length);
+    return file;
+}
+
+
+void unmap_file(file_map_t* file) {
+    if (!file || !file->data)
+        return;
+
+#ifndef _WIN32
+    if (file->is_mapped)
+        munmap(file->data, file->length);
+    else
+#endif
+        free(file->data);
+
+    file->data = NULL;
+    file->length = 0;
+    file->is_mapped = 0;
+}
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+    #include <io.h>
+    #define write _write
+#else
+    #include <unistd.h>
+#endif
+
+#include "../include/frame.h"
+
+// Decimal digits of every color channel value, padded to 3 bytes, followed
+// by how many of them there are
+static const char channel_digits[256][4] = {
+    {'0', 0, 0, 1}, {'1', 0, 0, 1}, {'2', 0, 0, 1}, {'3', 0, 0, 1}, {'4', 0, 0, 1}, {'5', 0, 0, 1}, {'6', 0, 0, 1}, {'7', 0, 0, 1},
+    {'8', 0, 0, 1}, {'9', 0, 0, 1}, {'1', '0', 0, 2}, {'1', '1', 0, 2}, {'1', '2', 0, 2}, {'1', '3', 0, 2}, {'1', '4', 0, 2}, {'1', '5', 0, 2},
+    {'1', '6', 0, 2}, {'1', '7', 0, 2}, {'1', '8', 0, 2}, {'1', '9', 0, 2}, {'2', '0', 0, 2}, {'2', '1', 0, 2}, {'2', '2', 0, 2}, {'2', '3', 0, 2},
+    {'2', '4', 0, 2}, {'2', '5', 0, 2}, {'2', '6', 0, 2}, {'2', '7', 0, 2}, {'2', '8', 0, 2}, {'2', '9', 0, 2}, {'3', '0', 0, 2}, {'3', '1', 0, 2},
+    {'3', '2', 0, 2}, {'3', '3', 0, 2}, {'3', '4', 0, 2}, {'3', '5', 0, 2}, {'3', '6', 0, 2}, {'3', '7', 0, 2}, {'3', '8', 0, 2}, {'3', '9', 0, 2},
+    {'4', '0', 0, 2}, {'4', '1', 0, 2}, {'4', '2', 0, 2}, {'4', '3', 0, 2}, {'4', '4', 0, 2}, {'4', '5', 0, 2}, {'4', '6', 0, 2}, {'4', '7', 0, 2},
+    {'4', '8', 0, 2}, {'4', '9', 0, 2}, {'5', '0', 0, 2}, {'5', '1', 0, 2}, {'5', '2', 0, 2}, {'5', '3', 0, 2}, {'5', '4', 0, 2}, {'5', '5', 0, 2},
+    {'5', '6', 0, 2}, {'5', '7', 0, 2}, {'5', '8', 0, 2}, {'5', '9', 0, 2}, {'6', '0', 0, 2}, {'6', '1', 0, 2}, {'6', '2', 0, 2}, {'6', '3', 0, 2},
+    {'6', '4', 0, 2}, {'6', '5', 0, 2}, {'6', '6', 0, 2}, {'6', '7', 0, 2}, {'6', '8', 0, 2}, {'6', '9', 0, 2}, {'7', '0', 0, 2}, {'7', '1', 0, 2},
+    {'7', '2', 0, 2}, {'7', '3', 0, 2}, {'7', '4', 0, 2}, {'7', '5', 0, 2}, {'7', '6', 0, 2}, {'7', '7', 0, 2}, {'7', '8', 0, 2}, {'7', '9', 0, 2},
+    {'8', '0', 0, 2}, {'8', '1', 0, 2}, {'8', '2', 0, 2}, {'8', '3', 0, 2}, {'8', '4', 0, 2}, {'8', '5', 0, 2}, {'8', '6', 0, 2}, {'8', '7', 0, 2},
+    {'8', '8', 0, 2}, {'8', '9', 0, 2}, {'9', '0', 0, 2}, {'9', '1', 0, 2}, {'9', '2', 0, 2}, {'9', '3', 0, 2}, {'9', '4', 0, 2}, {'9', '5', 0, 2},
+    {'9', '6', 0, 2}, {'9', '7', 0, 2}, {'9', '8', 0, 2}, {'9', '9', 0, 2}, {'1', '0', '0', 3}, {'1', '0', '1', 3}, {'1', '0', '2', 3}, {'1', '0', '3', 3},
+    {'1', '0', '4', 3}, {'1', '0', '5', 3}, {'1', '0', '6', 3}, {'1', '0', '7', 3}, {'1', '0', '8', 3}, {'1', '0', '9', 3}, {'1', '1', '0', 3}, {'1', '1', '1', 3},
+    {'1', '1', '2', 3}, {'1', '1', '3', 3}, {'1', '1', '4', 3}, {'1', '1', '5', 3}, {'1', '1', '6', 3}, {'1', '1', '7', 3}, {'1', '1', '8', 3}, {'1', '1', '9', 3},
+    {'1', '2', '0', 3}, {'1', '2', '1', 3}, {'1', '2', '2', 3}, {'1', '2', '3', 3}, {'1', '2', '4', 3}, {'1', '2', '5', 3}, {'1', '2', '6', 3}, {'1', '2', '7', 3},
+    {'1', '2', '8', 3}, {'1', '2', '9', 3}, {'1', '3', '0', 3}, {'1', '3', '1', 3}, {'1', '3', '2', 3}, {'1', '3', '3', 3}, {'1', '3', '4', 3}, {'1', '3', '5', 3},
+    {'1', '3', '6', 3}, {'1', '3', '7', 3}, {'1', '3', '8', 3}, {'1', '3', '9', 3}, {'1', '4', '0', 3}, {'1', '4', '1', 3}, {'1', '4', '2', 3}, {'1', '4', '3', 3},
+    {'1', '4', '4', 3}, {'1', '4', '5', 3}, {'1', '4', '6', 3}, {'1', '4', '7', 3}, {'1', '4', '8', 3}, {'1', '4', '9', 3}, {'1', '5', '0', 3}, {'1', '5', '1', 3},
+    {'1', '5', '2', 3}, {'1', '5', '3', 3}, {'1', '5', '4', 3}, {'1', '5', '5', 3}, {'1', '5', '6', 3}, {'1', '5', '7', 3}, {'1', '5', '8', 3}, {'1', '5', '9', 3},
+    {'1', '6', '0', 3}, {'1', '6', '1', 3}, {'1', '6', '2', 3}, {'1', '6', '3', 3}, {'1', '6', '4', 3}, {'1', '6', '5', 3}, {'1', '6', '6', 3}, {'1', '6', '7', 3},
+    {'1', '6', '8', 3}, {'1', '6', '9', 3}, {'1', '7', '0', 3}, {'1', '7', '1', 3}, {'1', '7', '2', 3}, {'1', '7', '3', 3}, {'1', '7', '4', 3}, {'1', '7', '5', 3},
+    {'1', '7', '6', 3}, {'1', '7', '7', 3}, {'1', '7', '8', 3}, {'1', '7', '9', 3}, {'1', '8', '0', 3}, {'1', '8', '1', 3}, {'1', '8', '2', 3}, {'1', '8', '3', 3},
+    {'1', '8', '4', 3}, {'1', '8', '5', 3}, {'1', '8', '6', 3}, {'1', '8', '7', 3}, {'1', '8', '8', 3}, {'1', '8', '9', 3}, {'1', '9', '0', 3}, {'1', '9', '1', 3},
+    {'1', '9', '2', 3}, {'1', '9', '3', 3}, {'1', '9', '4', 3}, {'1', '9', '5', 3}, {'1', '9', '6', 3}, {'1', '9', '7', 3}, {'1', '9', '8', 3}, {'1', '9', '9', 3},
+    {'2', '0', '0', 3}, {'2', '0', '1', 3}, {'2', '0', '2', 3}, {'2', '0', '3', 3}, {'2', '0', '4', 3}, {'2', '0', '5', 3}, {'2', '0', '6', 3}, {'2', '0', '7', 3},
+    {'2', '0', '8', 3}, {'2', '0', '9', 3}, {'2', '1', '0', 3}, {'2', '1', '1', 3}, {'2', '1', '2', 3}, {'2', '1', '3', 3}, {'2', '1', '4', 3}, {'2', '1', '5', 3},
+    {'2', '1', '6', 3}, {'2', '1', '7', 3}, {'2', '1', '8', 3}, {'2', '1', '9', 3}, {'2', '2', '0', 3}, {'2', '2', '1', 3}, {'2', '2', '2', 3}, {'2', '2', '3', 3},
+    {'2', '2', '4', 3}, {'2', '2', '5', 3}, {'2', '2', '6', 3}, {'2', '2', '7', 3}, {'2', '2', '8', 3}, {'2', '2', '9', 3}, {'2', '3', '0', 3}, {'2', '3', '1', 3},
+    {'2', '3', '2', 3}, {'2', '3', '3', 3}, {'2', '3', '4', 3}, {'2', '3', '5', 3}, {'2', '3', '6', 3}, {'2', '3', '7', 3}, {'2', '3', '8', 3}, {'2', '3', '9', 3},
+    {'2', '4', '0', 3}, {'2', '4', '1', 3}, {'2', '4', '2', 3}, {'2', '4', '3', 3}, {'2', '4', '4', 3}, {'2', '4', '5', 3}, {'2', '4', '6', 3}, {'2', '4', '7', 3},
+    {'2', '4', '8', 3}, {'2', '4', '9', 3}, {'2', '5', '0', 3}, {'2', '5', '1', 3}, {'2', '5', '2', 3}, {'2', '5', '3', 3}, {'2', '5', '4', 3}, {'2', '5', '5', 3}
+};
+
+
+frame_t make_frame(size_t capacity) {
+    frame_t frame = {0};
+    reserve_frame(&frame, capacity);
+    return frame;
+}
+
+
+void free_frame(frame_t* frame) {
+    if (frame && frame->data) {
+        free(frame->data);
+        frame->data = NULL;
+        frame->length = frame->capacity = 0;
+    }
+}
+
+
+// Copies the frame's bytes into a new frame, e.g. to replay them later
+frame_t copy_frame(const frame_t* frame) {
+    frame_t copy = make_frame(frame->length);
+    if (copy.data) {
+        memcpy(copy.data, frame->data, frame->length);
+        copy.length = frame->length;
+    }
+    copy.saved_bytes = frame->saved_bytes;
+    return copy;
+}
+
+
+// Empties the frame but keeps its allocation for the next one
+void clear_frame(frame_t* frame) {
+    frame->length = 0;
+    frame->has_fg = 0;
+    frame->has_bg = 0;
+}
+
+
+// Makes room for `extra` more bytes. Returns 1 if successful.
+int reserve_frame(frame_t* frame, size_t extra) {
+    size_t needed = frame->length + extra;
+    if (needed <= frame->capacity)
+        return 1;
+
+    size_t capacity = frame->capacity ? frame->capacity : 4096;
+    while (capacity < needed)
+        capacity *= 2;
+
+    char* data = realloc(frame->data, capacity);
+    if (!data) {
+        fprintf(stderr, "Error: Failed to allocate memory for frame buffer!\n");
+        return 0;
+    }
+
+    frame->data = data;
+    frame->capacity = capacity;
+    return 1;
+}
+
+
+void frame_append_char(frame_t* frame, char c) {
+    if (frame->length < frame->capacity || reserve_frame(frame, 1))
+        frame->data[frame->length++] = c;
+}
+
+
+void frame_append_string(frame_t* frame, const char* string) {
+    size_t length = strlen(string);
+    if (!reserve_frame(frame, length))
+        return;
+
+    memcpy(frame->data + frame->length, string, length);
+    frame->length += length;
+}
+
+
+// Writes decimal digits of `value` without going through printf
+void frame_append_uint(frame_t* frame, size_t value) {
+    char digits[20];
+    size_t n_digits = 0;
+
+    do {
+        digits[n_digits++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    if (!reserve_frame(frame, n_digits))
+        return;
+
+    while (n_digits)
+        frame->data[frame->length++] = digits[--n_digits];
+}
+
+
+// Writes a color channel in [0, 255] by copying its digits from the table,
+// which avoids dividing and branching on the number of digits. Four bytes
+// are always copied, so the caller must have reserved 4 bytes and writes
+// over the spare ones afterwards.
+static char* write_channel(char* out, int value) {
+    const char* digits = channel_digits[value & 0xff];
+    memcpy(out, digits, 4);
+    return out + digits[3];
+}
+
+
+// Appends a 24-bit truecolor escape code, "\x1b[38;2;..." for the foreground
+// or "\x1b[48;2;..." for the background
+static void append_rgb_escape(frame_t* frame, char layer, int r, int g, int b) {
+    // Longest form is "\x1b[38;2;255;255;255m"
+    if (!reserve_frame(frame, 19))
+        return;
+
+    char* out = frame->data + frame->length;
+    memcpy(out, "\x1b[38;2;", 7);
+    out[2] = layer;
+    out = write_channel(out + 7, r);
+    *out++ = ';';
+    out = write_channel(out, g);
+    *out++ = ';';
+    out = write_channel(out, b);
+    *out++ = 'm';
+
+    frame->length = (size_t) (out - frame->data);
+}
+
+
+// Appends 24-bit truecolor foreground escape code
+void frame_append_fg_color(frame_t* frame, int r, int g, int b) {
+    append_rgb_escape(frame, '3', r, g, b);
+}
+
+
+static size_t count_digits(int value) {
+    return value >= 100 ? 3 : value >= 10 ? 2 : 1;
+}
+
+
+// Appends foreground escape code only if the color differs from the last one
+void frame_set_fg_color(frame_t* frame, int r, int g, int b) {
+    if (frame->has_fg && frame->fg_index < 0 && frame->fg_r == r && frame->fg_g == g && frame->fg_b == b) {
+        // "\x1b[38;2;" + ";" + ";" + "m"
+        frame->saved_bytes += 10 + count_digits(r) + count_digits(g) + count_digits(b);
+        return;
+    }
+
+    frame_append_fg_color(frame, r, g, b);
+    frame->has_fg = 1;
+    frame->fg_index = -1;
+    frame->fg_r = r, frame->fg_g = g, frame->fg_b = b;
+}
+
+
+// Appends "\x1b[38;5;<index>m", or "\x1b[48;5;<index>m" for the background
+static void append_256_escape(frame_t* frame, char layer, int index) {
+    if (!reserve_frame(frame, 11))
+        return;
+    char* out = frame->data + frame->length;
+    memcpy(out, "\x1b[38;5;", 7);
+    out[2] = layer;
+    out = write_channel(out + 7, index);
+    *out++ = 'm';
+    frame->length = (size_t) (out - frame->data);
+}
+
+
+// Appends "\x1b[3<n>m", or "\x1b[9<n>m" for bright colors 8-15. Backgrounds
+// are 40-47 and 100-107.
+static void append_16_escape(frame_t* frame, int is_background, int index) {
+    if (!reserve_frame(frame, 6))
+        return;
+    char* out = frame->data + frame->length;
+    *out++ = '\x1b';
+    *out++ = '[';
+    if (is_background && index >= 8) {
+        *out++ = '1';
+        *out++ = '0';
+    } else {
+        *out++ = is_background ? '4' : index < 8 ? '3' : '9';
+    }
+    *out++ = (char) ('0' + index % 8);
+    *out++ = 'm';
+    frame->length = (size_t) (out - frame->data);
+}
+
+
+// Appends a 256-color foreground code only if the color differs from the last one
+void frame_set_fg_256(frame_t* frame, int index) {
+    if (frame->has_fg && frame->fg_index == index) {
+        // "\x1b[38;5;" + "m"
+        frame->saved_bytes += 8 + count_digits(index);
+        return;
+    }
+
+    append_256_escape(frame, '3', index);
+    frame->has_fg = 1;
+    frame->fg_index = index;
+}
+
+
+// Appends a 16-color foreground code only if the color differs from the last one
+void frame_set_fg_16(frame_t* frame, int index) {
+    if (frame->has_fg && frame->fg_index == index) {
+        frame->saved_bytes += 5;
+        return;
+    }
+
+    append_16_escape(frame, 0, index);
+    frame->has_fg = 1;
+    frame->fg_index = index;
+}
+
+
+// Appends background escape code only if the color differs from the last one
+void frame_set_bg_color(frame_t* frame, int r, int g, int b) {
+    if (frame->has_bg && frame->bg_index < 0 && frame->bg_r == r && frame->bg_g == g && frame->bg_b == b) {
+        frame->saved_bytes += 10 + count_digits(r) + count_digits(g) + count_digits(b);
+        return;
+    }
+
+    append_rgb_escape(frame, '4', r, g, b);
+    frame->has_bg = 1;
+    frame->bg_index = -1;
+    frame->bg_r = r, frame->bg_g = g, frame->bg_b = b;
+}
+
+
+void frame_set_bg_256(frame_t* frame, int index) {
+    if (frame->has_bg && frame->bg_index == index) {
+        frame->saved_bytes += 8 + count_digits(index);
+        return;
+    }
+
+    append_256_escape(frame, '4', index);
+    frame->has_bg = 1;
+    frame->bg_index = index;
+}
+
+
+void frame_set_bg_16(frame_t* frame, int index) {
+    if (frame->has_bg && frame->bg_index == index) {
+        frame->saved_bytes += index < 8 ? 5 : 6;
+        return;
+    }
+
+    append_16_escape(frame, 1, index);
+    frame->has_bg = 1;
+    frame->bg_index = index;
+}
+
+
+// Goes back to the terminal's default background, e.g. before a newline so
+// a scrolling terminal doesn't fill the new line with the last color
+void frame_reset_bg(frame_t* frame) {
+    if (frame->has_bg)
+        frame_append_string(frame, "\x1b[49m");
+    frame->has_bg = 0;
+}
+
+
+// Appends a cursor movement "\x1b[<n><direction>", leaving out n when it is 1
+static void append_cursor_step(frame_t* frame, size_t n, char direction) {
+    frame_append_string(frame, "\x1b[");
+    if (n != 1)
+        frame_append_uint(frame, n);
+    frame_append_char(frame, direction);
+}
+
+
+// Appends relative cursor movement from one cell to another
+void frame_move_cursor(frame_t* frame, size_t from_row, size_t from_column, size_t to_row, size_t to_column) {
+    if (to_row > from_row)
+        append_cursor_step(frame, to_row - from_row, 'B');
+    else if (to_row < from_row)
+        append_cursor_step(frame, from_row - to_row, 'A');
+
+    if (to_column == from_column)
+        return;
+    if (to_column == 0)
+        frame_append_char(frame, '\r');
+    else if (to_column > from_column)
+        append_cursor_step(frame, to_column - from_column, 'C');
+    else
+        append_cursor_step(frame, from_column - to_column, 'D');
+}
+
+
+// Appends reset escape code and forgets the last emitted color
+void frame_reset_colors(frame_t* frame) {
+    frame_append_string(frame, "\x1b[0m");
+    frame->has_fg = 0;
+    frame->has_bg = 0;
+}
+
+
+static char* write_hex_color(char* out, int r, int g, int b) {
+    static const char hex[] = "0123456789abcdef";
+    int channels[3] = {r, g, b};
+    *out++ = '#';
+    for (size_t i = 0; i < 3; i++) {
+        *out++ = hex[(channels[i] >> 4) & 0xf];
+        *out++ = hex[channels[i] & 0xf];
+    }
+    return out;
+}
+
+
+// Opens a span with the colors, closing the previous one, unless it is
+// already open. A negative bg_r means no background.
+void frame_set_html_colors(frame_t* frame, int r, int g, int b, int bg_r, int bg_g, int bg_b) {
+    int has_bg = bg_r >= 0;
+    if (frame->has_fg && frame->fg_index < 0 && frame->fg_r == r && frame->fg_g == g && frame->fg_b == b
+        && frame->has_bg == has_bg && (!has_bg || (frame->bg_r == bg_r && frame->bg_g == bg_g && frame->bg_b == bg_b))) {
+        // "<span style=\"color:#rrggbb\">" + "</span>", plus ";background:#rrggbb"
+        frame->saved_bytes += has_bg ? 54 : 35;
+        return;
+    }
+
+    if (!reserve_frame(frame, has_bg ? 54 : 35))
+        return;
+    if (frame->has_fg)
+        frame_append_string(frame, "</span>");
+
+    char* out = frame->data + frame->length;
+    memcpy(out, "<span style=\"color:", 19);
+    out = write_hex_color(out + 19, r, g, b);
+    if (has_bg) {
+        memcpy(out, ";background:", 12);
+        out = write_hex_color(out + 12, bg_r, bg_g, bg_b);
+    }
+    memcpy(out, "\">", 2);
+    out += 2;
+
+    frame->length = (size_t) (out - frame->data);
+    frame->has_fg = 1;
+    frame->fg_index = -1;
+    frame->fg_r = r, frame->fg_g = g, frame->fg_b = b;
+    frame->has_bg = has_bg;
+    frame->bg_index = -1;
+    frame->bg_r = bg_r, frame->bg_g = bg_g, frame->bg_b = bg_b;
+}
+
+
+// Opens a span with the color, closing the previous one, unless it is already open
+void frame_set_html_color(frame_t* frame, int r, int g, int b) {
+    frame_set_html_colors(frame, r, g, b, -1, -1, -1);
+}
+
+
+// Closes the open span, if any, and forgets its color
+void frame_close_html_span(frame_t* frame) {
+    if (frame->has_fg)
+        frame_append_string(frame, "</span>");
+    frame->has_fg = 0;
+    frame->has_bg = 0;
+}
+
+
+// Appends a character, escaping the ones HTML gives a meaning to
+void frame_append_html_char(frame_t* frame, char c) {
+    if (c == '&')
+        frame_append_string(frame, "&amp;");
+    else if (c == '<')
+        frame_append_string(frame, "&lt;");
+    else if (c == '>')
+        frame_append_string(frame, "&gt;");
+    else
+        frame_append_char(frame, c);
+}
+
+
+// Writes the whole frame to `fd`. Returns 1 if successful.
+int write_frame(frame_t* frame, int fd) {
+    // Anything still sitting in stdio's buffer has to go out first
+    fflush(stdout);
+
+    size_t written = 0;
+    while (written < frame->length) {
+        long result = (long) write(fd, frame->data + written, frame->length - written);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error: Failed to write frame!\n");
+            return 0;
+        }
+        written += (size_t) result;
+    }
+
+    return 1;
+}
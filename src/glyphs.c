@@ -0,0 +1,131 @@
+#include "../include/glyphs.h"
+
+// SIMD kernels need GCC/Clang target attributes on x86
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define GLYPH_SIMD 1
+#endif
+
+#define FIRST_GLYPH ' '
+#define N_GLYPHS 95 // Printable ascii, ' ' to '~'
+
+// Ink coverage of each printable ascii character, from ' ' on. Rasterized
+// from DejaVu Sans Mono at 96 px and area-averaged onto the 4x8 grid, with a
+// sample counted as ink at 15% coverage. Only 'O' and 'Q' share a mask.
+static const uint32_t glyph_masks[N_GLYPHS] = {
+    0x00000000, 0x00066660, 0x00006660, 0x057ffe80, 0x06ee7e40, 0x0ccff320,
+    0x0efd3360, 0x00000660, 0x44622640, 0x22644620, 0x0000f600, 0x006f6000,
+    0x26600000, 0x00060000, 0x06600000, 0x03224480, 0x06ffff60, 0x0e644660,
+    0x0f36cc70, 0x07cc6c70, 0x04ff6640, 0x07dc7370, 0x06fbf360, 0x02264cf0,
+    0x06ffef60, 0x06ceff60, 0x06606000, 0x26606000, 0x00c7e800, 0x00fff000,
+    0x003e7100, 0x02264c60, 0x63fbff40, 0x09ff6660, 0x07ffff70, 0x06b333e0,
+    0x07f99d70, 0x0e33f3f0, 0x0233f3e0, 0x06bd53e0, 0x099bf990, 0x0e6666f0,
+    0x07544460, 0x09d77790, 0x0e333330, 0x099fffb0, 0x0ddffbb0, 0x06f99f60,
+    0x0037fb70, 0x06f99f60, 0x0997fd70, 0x06dc7360, 0x006666f0, 0x06fbbb90,
+    0x0666fb90, 0x06fff990, 0x09f66e90, 0x00666f90, 0x0f324cf0, 0x66222260,
+    0x0c462310, 0x66444460, 0x00009f60, 0xf0000000, 0x00000020, 0x0effc600,
+    0x07fbf730, 0x06232600, 0x0efdfec0, 0x0e3ff600, 0x02666ec0, 0x6efdf600,
+    0x08fff730, 0x0f666260, 0x74446640, 0x0af77b30, 0x0c622230, 0x09ffff00,
+    0x08fff600, 0x06f9f600, 0x37fbf600, 0x8efdfe00, 0x02226e00, 0x06c63600,
+    0x0c222720, 0x0efff000, 0x0666f900, 0x06ff9900, 0x09666900, 0x3666f900,
+    0x0e26c600, 0x46626640, 0x66666660, 0x26646620, 0x000f2000
+};
+
+
+// Nearest glyph by Hamming distance, the first one on ties
+static inline char match_glyph(uint32_t pattern) {
+    size_t best = 0;
+    int best_distance = 33;
+    for (size_t i = 0; i < N_GLYPHS; i++) {
+        int distance = __builtin_popcount(pattern ^ glyph_masks[i]);
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    return (char) (FIRST_GLYPH + best);
+}
+
+
+static void match_glyph_row_scalar(const uint32_t* patterns, char* out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = match_glyph(patterns[i]);
+}
+
+
+#ifdef GLYPH_SIMD
+
+// The same loop, with match_glyph inlined where popcnt is one instruction
+__attribute__((target("popcnt")))
+static void match_glyph_row_popcnt(const uint32_t* patterns, char* out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = match_glyph(patterns[i]);
+}
+
+
+// Eight patterns at a time, one per lane, against every mask in turn. Each
+// lane keeps the first glyph with the smallest distance, as match_glyph does.
+
+__attribute__((target("avx2")))
+static void match_glyph_row_avx2(const uint32_t* patterns, char* out, size_t n) {
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const __m256i nibble_counts = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i ones_8 = _mm256_set1_epi8(1);
+    const __m256i ones_16 = _mm256_set1_epi16(1);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i pattern = _mm256_loadu_si256((const __m256i*) &patterns[i]);
+        __m256i best = _mm256_setzero_si256();
+        __m256i best_distance = _mm256_set1_epi32(33);
+
+        for (int g = 0; g < N_GLYPHS; g++) {
+            __m256i bits = _mm256_xor_si256(pattern, _mm256_set1_epi32((int) glyph_masks[g]));
+
+            // Popcount of each byte from its two nibbles, then summed per lane
+            __m256i low = _mm256_and_si256(bits, nibble_mask);
+            __m256i high = _mm256_and_si256(_mm256_srli_epi16(bits, 4), nibble_mask);
+            __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, low), _mm256_shuffle_epi8(nibble_counts, high));
+            __m256i distance = _mm256_madd_epi16(_mm256_maddubs_epi16(counts, ones_8), ones_16);
+
+            __m256i closer = _mm256_cmpgt_epi32(best_distance, distance);
+            best_distance = _mm256_min_epi32(best_distance, distance);
+            best = _mm256_blendv_epi8(best, _mm256_set1_epi32(g), closer);
+        }
+
+        uint32_t indices[8];
+        _mm256_storeu_si256((__m256i*) indices, best);
+        for (size_t k = 0; k < 8; k++)
+            out[i + k] = (char) (FIRST_GLYPH + indices[k]);
+    }
+
+    match_glyph_row_scalar(patterns + i, out + i, n - i);
+}
+
+#endif
+
+
+// Picks the printable ascii character whose shape is closest to each pattern
+void match_glyph_row_isa(color_isa_t isa, const uint32_t* patterns, char* out, size_t n) {
+#ifdef GLYPH_SIMD
+    if (isa > get_color_isa())
+        isa = get_color_isa();
+    if (isa == COLOR_ISA_AVX2) {
+        match_glyph_row_avx2(patterns, out, n);
+        return;
+    }
+    if (isa == COLOR_ISA_SSE4 && __builtin_cpu_supports("popcnt")) {
+        match_glyph_row_popcnt(patterns, out, n);
+        return;
+    }
+#endif
+    (void) isa;
+    match_glyph_row_scalar(patterns, out, n);
+}
+
+
+void match_glyph_row(const uint32_t* patterns, char* out, size_t n) {
+    match_glyph_row_isa(get_color_isa(), patterns, out, n);
+}
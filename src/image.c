@@ -1,47 +1,22 @@
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-#define STB_IMAGE_IMPLEMENTATION
-#include "../include/stb_image.h"
-#pragma GCC diagnostic pop
+#include <stdio.h>
+#include <string.h>
 
 #include "../include/image.h"
+#include "../include/parallel.h"
 
 
-image_t load_image(const char* file_path) {
-    int width, height, channels;
-    unsigned char* raw_data = stbi_load(file_path, &width, &height, &channels, 0);
-
-    if (!raw_data) {
-        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", file_path, stbi_failure_reason());
-        return (image_t) {0}; // Return empty image on failure
-    }
-
-    // Convert to [0., 1.]
-    size_t total_size = (size_t) width * height * channels;
-    double* data = calloc(total_size, sizeof(*data));
-    if (!data) {
-        fprintf(stderr, "Error: Failed to allocate memory for image data!\n");
-        stbi_image_free(raw_data);
-        return (image_t) {0}; // Return empty image on failure
-    }
-
-    for (size_t i = 0; i < total_size; i++) {
-        data[i] = raw_data[i] / 255.0;
+void free_image(image_t* image) {
+    if (image && image->data) {
+        free(image->data);
+        image->data = NULL;
+        image->width = image->height = image->channels = 0;
     }
-
-    stbi_image_free(raw_data);
-
-    return (image_t) {
-        .width = (size_t) width,
-        .height = (size_t) height,
-        .channels = (size_t) channels,
-        .data = data
-    };
 }
 
 
-void free_image(image_t* image) {
+void free_image_u8(image_u8_t* image) {
     if (image && image->data) {
+        // stb_image allocates with malloc, so free works for its buffers too
         free(image->data);
         image->data = NULL;
         image->width = image->height = image->channels = 0;
@@ -89,18 +64,24 @@ void get_average(image_t* image, double* average, size_t x1, size_t x2, size_t y
 }
 
 
-image_t make_resized(image_t* original, size_t max_width, size_t max_height, double character_ratio) {
-    size_t width, height;
-    size_t channels = original->channels;
-
+// Gets size of resized image that fits in max_width x max_height characters
+void get_resized_dimensions(size_t width, size_t height, size_t max_width, size_t max_height, double character_ratio, size_t* out_width, size_t* out_height) {
     // Note: Dividing heights by 2 for approximate terminal font aspect ratio
-    size_t proposed_height = (original->height * max_width) / (character_ratio * original->width);
+    size_t proposed_height = (height * max_width) / (character_ratio * width);
     if (proposed_height <= max_height) {
-        width = max_width, height = proposed_height;
+        *out_width = max_width, *out_height = proposed_height;
     } else {
-        width = (character_ratio * original->width * max_height) / (original->height);
-        height = max_height;
+        *out_width = (character_ratio * width * max_height) / (height);
+        *out_height = max_height;
     }
+}
+
+
+image_t make_resized(image_t* original, size_t max_width, size_t max_height, double character_ratio) {
+    size_t width, height;
+    size_t channels = original->channels;
+
+    get_resized_dimensions(original->width, original->height, max_width, max_height, character_ratio, &width, &height);
 
     double* data = calloc(width * height * channels, sizeof(*data));
     if (!data) {
@@ -112,9 +93,11 @@ image_t make_resized(image_t* original, size_t max_width, size_t max_height, dou
     for (size_t j = 0; j < height; j++) {
         size_t y1 = (j * original->height) / (height);
         size_t y2 = ((j + 1) * original->height) / (height);
+        if (y2 == y1) y2++; // Upscaling; use nearest row
         for (size_t i = 0; i < width; i++) {
             size_t x1 = (i * original->width) / (width);
             size_t x2 = ((i + 1) * original->width) / (width);
+            if (x2 == x1) x2++;
 
             get_average(original, &data[(i + j * width) * channels], x1, x2, y1, y2);
         }
@@ -129,37 +112,154 @@ image_t make_resized(image_t* original, size_t max_width, size_t max_height, dou
 }
 
 
-// Create grayscale version of image. Note: Assumes original is at least RGB.
+typedef struct {
+    image_u8_t* original;
+    image_t* resized;
+    int failed;
+} resample_context_t;
+
+
+// Averages 8-bit source samples for output rows [begin, end) with a summed-area
+// table. Output rows partition the source into bands, so only one band's
+// table (a row of prefix sums over column totals) is needed at a time, and
+// each output cell costs O(channels) regardless of the downscale ratio.
+static void resample_rows(void* context, size_t begin, size_t end, size_t band) {
+    (void) band;
+    resample_context_t* resample = context;
+    image_u8_t* original = resample->original;
+    size_t width = resample->resized->width;
+    size_t height = resample->resized->height;
+    size_t channels = original->channels;
+    size_t row_length = original->width * channels;
+    double* data = resample->resized->data;
+
+    unsigned int* column_sums = malloc(row_length * sizeof(*column_sums));
+    unsigned long long* table = malloc((row_length + channels) * sizeof(*table));
+    if (!column_sums || !table) {
+        resample->failed = 1;
+        free(column_sums);
+        free(table);
+        return;
+    }
+
+    // j, i are coordinates in resized image
+    for (size_t j = begin; j < end; j++) {
+        size_t y1 = (j * original->height) / (height);
+        size_t y2 = ((j + 1) * original->height) / (height);
+        if (y2 == y1) y2++; // Upscaling; use nearest row
+
+        // Sum each column of the band
+        memset(column_sums, 0, row_length * sizeof(*column_sums));
+        for (size_t y = y1; y < y2; y++) {
+            const unsigned char* row = &original->data[y * row_length];
+            for (size_t k = 0; k < row_length; k++) {
+                column_sums[k] += row[k];
+            }
+        }
+
+        // table[x * channels + c] is the band total of channel c left of x
+        for (size_t c = 0; c < channels; c++) {
+            table[c] = 0;
+        }
+        for (size_t k = 0; k < row_length; k++) {
+            table[k + channels] = table[k] + column_sums[k];
+        }
+
+        for (size_t i = 0; i < width; i++) {
+            size_t x1 = (i * original->width) / (width);
+            size_t x2 = ((i + 1) * original->width) / (width);
+            if (x2 == x1) x2++;
+
+            double* pixel = &data[(i + j * width) * channels];
+            double scale = 1.0 / (255.0 * (x2 - x1) * (y2 - y1));
+            for (size_t c = 0; c < channels; c++) {
+                pixel[c] = (table[x2 * channels + c] - table[x1 * channels + c]) * scale;
+            }
+        }
+    }
+
+    free(column_sums);
+    free(table);
+}
+
+
+// Averages 8-bit source samples down to exactly width x height, splitting the
+// output rows across n_threads
+image_t make_resampled_u8(image_u8_t* original, size_t width, size_t height, size_t n_threads) {
+    image_t resized = {
+        .width = width,
+        .height = height,
+        .channels = original->channels,
+        .data = malloc(width * height * original->channels * sizeof(double)) // Every sample is written
+    };
+
+    resample_context_t context = {
+        .original = original,
+        .resized = &resized,
+        .failed = !resized.data
+    };
+
+    if (!context.failed)
+        run_bands(height, n_threads, resample_rows, &context);
+
+    if (context.failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for resized image!\n");
+        free_image(&resized);
+        return (image_t) {0};
+    }
+
+    return resized;
+}
+
+
+// Same as make_resized, but for 8-bit source images
+image_t make_resized_u8(image_u8_t* original, size_t max_width, size_t max_height, double character_ratio) {
+    size_t width, height;
+    get_resized_dimensions(original->width, original->height, max_width, max_height, character_ratio, &width, &height);
+
+    return make_resampled_u8(original, width, height, 1);
+}
+
+
+// Luminance-weighted grayscale of every pixel, into width * height doubles.
+// Gray and gray + alpha images already are their luminance.
+void get_grayscale(image_t* original, double* out) {
+    size_t n_pixels = original->width * original->height;
+    size_t channels = original->channels;
+
+    if (channels <= 2) {
+        for (size_t i = 0; i < n_pixels; i++)
+            out[i] = original->data[i * channels];
+        return;
+    }
+
+    for (size_t i = 0; i < n_pixels; i++) {
+        const double* pixel = &original->data[i * channels];
+        out[i] = 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
+    }
+}
+
+
+// Create grayscale version of image
 image_t make_grayscale(image_t* original) {
     size_t width = original->width;
     size_t height = original->height;
-    size_t channels = 1;
 
-    double* data = calloc(width * height, sizeof(*data));
+    // Every pixel is written, so there is nothing to zero
+    double* data = malloc(width * height * sizeof(*data));
     if (!data) {
         fprintf(stderr, "Error: Failed to allocate memory for resized image!\n");
         return (image_t) {0};
     }
 
-    image_t new = {
+    get_grayscale(original, data);
+
+    return (image_t) {
         .width = width,
         .height = height,
-        .channels = channels,
+        .channels = 1,
         .data = data
     };
-
-    for (size_t y = 0; y < height; y++) {
-        for (size_t x = 0; x < width; x++) {
-            double* pixel = get_pixel(original, x, y);
-
-            // Luminance-weighted graycsale. Could be a callback...
-            double grayscale = 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
-
-            set_pixel(&new, x, y, &grayscale);
-        }
-    }
-
-    return new;
 }
 
 
@@ -179,9 +279,14 @@ double calculate_convolution_value(image_t* image, double* kernel, size_t x, siz
 }
 
 
-// Calculates convolution with 3x3 kernel. Ignores edges.
-void get_convolution(image_t* image, double* kernel, double* out) {
-    for (size_t y = 1; y < image->height - 1; y++) {
+// Calculates convolution with 3x3 kernel for rows [begin, end). Ignores edges.
+void get_convolution_rows(image_t* image, double* kernel, double* out, size_t begin, size_t end) {
+    if (begin < 1)
+        begin = 1;
+    if (end > image->height - 1)
+        end = image->height - 1;
+
+    for (size_t y = begin; y < end; y++) {
         for (size_t x = 1; x < image->width - 1; x++) {
             for (size_t c = 0; c < image->channels; c++) {
                 size_t image_index = c + (x + y * image->width) * image->channels;
@@ -192,11 +297,23 @@ void get_convolution(image_t* image, double* kernel, double* out) {
 }
 
 
-// Calculates sobel convolutions
-void get_sobel(image_t* image, double* out_x, double* out_y) {
+// Calculates convolution with 3x3 kernel. Ignores edges.
+void get_convolution(image_t* image, double* kernel, double* out) {
+    get_convolution_rows(image, kernel, out, 0, image->height);
+}
+
+
+// Calculates sobel convolutions for rows [begin, end)
+void get_sobel_rows(image_t* image, double* out_x, double* out_y, size_t begin, size_t end) {
     double Gx[] = {-1., 0., 1., -2., 0., 2., -1., 0., 1};
     double Gy[] = {1., 2., 1., 0., 0., 0., -1., -2., -1};
 
-    get_convolution(image, Gx, out_x);
-    get_convolution(image, Gy, out_y);
+    get_convolution_rows(image, Gx, out_x, begin, end);
+    get_convolution_rows(image, Gy, out_y, begin, end);
+}
+
+
+// Calculates sobel convolutions
+void get_sobel(image_t* image, double* out_x, double* out_y) {
+    get_sobel_rows(image, out_x, out_y, 0, image->height);
 }
@@ -0,0 +1,397 @@
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb_image.h"
+#pragma GCC diagnostic pop
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+#endif
+
+#include "../include/image.h"
+#include "../include/file_map.h"
+
+
+// Decodes a file through a memory mapping rather than stdio buffering
+static unsigned char* load_mapped(const char* file_path, int* width, int* height, int* channels) {
+    file_map_t file = map_file(file_path);
+    if (!file.data) {
+        stbi__err("can't fopen", "Unable to open file");
+        return NULL;
+    }
+
+    unsigned char* data = stbi_load_from_memory(file.data, (int) file.length, width, height, channels, 0);
+    unmap_file(&file);
+    return data;
+}
+
+
+image_t load_image(const char* file_path) {
+    int width, height, channels;
+    unsigned char* raw_data = load_mapped(file_path, &width, &height, &channels);
+
+    if (!raw_data) {
+        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", file_path, stbi_failure_reason());
+        return (image_t) {0}; // Return empty image on failure
+    }
+
+    // Convert to [0., 1.]
+    size_t total_size = (size_t) width * height * channels;
+    double* data = calloc(total_size, sizeof(*data));
+    if (!data) {
+        fprintf(stderr, "Error: Failed to allocate memory for image data!\n");
+        stbi_image_free(raw_data);
+        return (image_t) {0}; // Return empty image on failure
+    }
+
+    for (size_t i = 0; i < total_size; i++) {
+        data[i] = raw_data[i] / 255.0;
+    }
+
+    stbi_image_free(raw_data);
+
+    return (image_t) {
+        .width = (size_t) width,
+        .height = (size_t) height,
+        .channels = (size_t) channels,
+        .data = data
+    };
+}
+
+
+// Loads image keeping stb_image's 8-bit samples
+image_u8_t load_image_u8(const char* file_path) {
+    int width, height, channels;
+    unsigned char* data = load_mapped(file_path, &width, &height, &channels);
+
+    if (!data) {
+        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", file_path, stbi_failure_reason());
+        return (image_u8_t) {0}; // Return empty image on failure
+    }
+
+    return (image_u8_t) {
+        .width = (size_t) width,
+        .height = (size_t) height,
+        .channels = (size_t) channels,
+        .data = data
+    };
+}
+
+
+// Reduced inverse DCTs. The top-left n x n coefficients of a block are run
+// through an n-point IDCT, giving an n x n block that stands in for the
+// average of each (8 / n) x (8 / n) region of the full 8 x 8 block. Weights
+// are c(u) * cos((2x + 1) * u * pi / 2n), with c(0) = 1 / sqrt(2).
+static const float IDCT_2_WEIGHTS[2][2] = {
+    {0.70710678f, 0.70710678f},
+    {0.70710678f, -0.70710678f}
+};
+
+static const float IDCT_4_WEIGHTS[4][4] = {
+    {0.70710678f, 0.92387953f, 0.70710678f, 0.38268343f},
+    {0.70710678f, 0.38268343f, -0.70710678f, -0.92387953f},
+    {0.70710678f, -0.38268343f, -0.70710678f, 0.92387953f},
+    {0.70710678f, -0.92387953f, 0.70710678f, -0.38268343f}
+};
+
+
+static stbi_uc clamp_sample(float value) {
+    // Undo level shift and round
+    value += 128.5f;
+    if (value < 0.0f)
+        return 0;
+    if (value > 255.0f)
+        return 255;
+    return (stbi_uc) value;
+}
+
+
+static void idct_reduced(stbi_uc* out, int out_stride, const short data[64], size_t n, const float* weights) {
+    float rows[4][4];
+
+    // Horizontal pass over the kept coefficient rows
+    for (size_t v = 0; v < n; v++) {
+        for (size_t x = 0; x < n; x++) {
+            float sum = 0.0f;
+            for (size_t u = 0; u < n; u++) {
+                sum += weights[x * n + u] * data[v * 8 + u];
+            }
+            rows[v][x] = sum;
+        }
+    }
+
+    // Vertical pass; 1/2 per dimension keeps the DC gain at 1/8
+    for (size_t y = 0; y < n; y++) {
+        for (size_t x = 0; x < n; x++) {
+            float sum = 0.0f;
+            for (size_t v = 0; v < n; v++) {
+                sum += weights[y * n + v] * rows[v][x];
+            }
+            out[y * out_stride + x] = clamp_sample(0.25f * sum);
+        }
+    }
+}
+
+
+static void idct_block_1(stbi_uc* out, int out_stride, short data[64]) {
+    (void) out_stride;
+    out[0] = clamp_sample(data[0] / 8.0f);
+}
+
+
+static void idct_block_2(stbi_uc* out, int out_stride, short data[64]) {
+    idct_reduced(out, out_stride, data, 2, &IDCT_2_WEIGHTS[0][0]);
+}
+
+
+static void idct_block_4(stbi_uc* out, int out_stride, short data[64]) {
+    idct_reduced(out, out_stride, data, 4, &IDCT_4_WEIGHTS[0][0]);
+}
+
+
+// Decodes a baseline or progressive JPEG at 1 / scale of its size, for scale
+// of 2, 4 or 8. Only the low-frequency coefficients of each block go through
+// the IDCT. Returns an empty image for anything it doesn't handle, so the
+// caller can fall back to a full decode.
+static image_u8_t load_jpeg_scaled(const unsigned char* buffer, size_t length, size_t scale) {
+    image_u8_t image = {0};
+    stbi__context context;
+    stbi__jpeg* jpeg = malloc(sizeof(*jpeg));
+    if (!jpeg)
+        return image;
+
+    stbi__start_mem(&context, buffer, (int) length);
+    jpeg->s = &context;
+    stbi__setup_jpeg(jpeg);
+    jpeg->s->img_n = 0; // makes stbi__cleanup_jpeg safe
+
+    size_t n = 8 / scale; // samples kept per block side
+    jpeg->idct_block_kernel = n == 1 ? idct_block_1 : n == 2 ? idct_block_2 : idct_block_4;
+
+    if (!stbi__decode_jpeg_image(jpeg))
+        goto cleanup;
+
+    // Leave CMYK, Adobe RGB and other oddities to stb_image
+    int is_rgb = jpeg->s->img_n == 3 && (jpeg->rgb == 3 || (jpeg->app14_color_transform == 0 && !jpeg->jfif));
+    if ((jpeg->s->img_n != 1 && jpeg->s->img_n != 3) || is_rgb)
+        goto cleanup;
+
+    size_t channels = (size_t) jpeg->s->img_n;
+    size_t width = (jpeg->s->img_x * n + 7) / 8;
+    size_t height = (jpeg->s->img_y * n + 7) / 8;
+
+    // Extra byte because stb_image's color conversion always writes an alpha
+    unsigned char* data = malloc(width * height * channels + 1);
+    unsigned char* lines = malloc(width * channels);
+    size_t* offsets = malloc(width * channels * sizeof(*offsets));
+    if (!data || !lines || !offsets) {
+        free(data);
+        free(lines);
+        free(offsets);
+        goto cleanup;
+    }
+
+    // Offset of each output column's sample within a component row. Reduced
+    // samples sit in the top-left n x n corner of each 8 x 8 block, and
+    // subsampled chroma is upsampled by nearest neighbour.
+    for (size_t k = 0; k < channels; k++) {
+        size_t h_step = (size_t) (jpeg->img_h_max / jpeg->img_comp[k].h);
+        size_t component_width = ((size_t) jpeg->img_comp[k].x * n + 7) / 8;
+        for (size_t x = 0; x < width; x++) {
+            size_t cx = x / h_step;
+            if (cx >= component_width)
+                cx = component_width - 1;
+            offsets[k * width + x] = (cx / n) * 8 + cx % n;
+        }
+    }
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t k = 0; k < channels; k++) {
+            size_t v_step = (size_t) (jpeg->img_v_max / jpeg->img_comp[k].v);
+            size_t component_height = ((size_t) jpeg->img_comp[k].y * n + 7) / 8;
+
+            size_t cy = y / v_step;
+            if (cy >= component_height)
+                cy = component_height - 1;
+            const stbi_uc* row = jpeg->img_comp[k].data + ((cy / n) * 8 + cy % n) * jpeg->img_comp[k].w2;
+
+            unsigned char* line = lines + k * width;
+            const size_t* offset = offsets + k * width;
+            for (size_t x = 0; x < width; x++) {
+                line[x] = row[offset[x]];
+            }
+        }
+
+        unsigned char* out = data + y * width * channels;
+        if (channels == 1) {
+            memcpy(out, lines, width);
+        } else {
+            jpeg->YCbCr_to_RGB_kernel(out, lines, lines + width, lines + 2 * width, (int) width, 3);
+        }
+    }
+
+    free(offsets);
+    free(lines);
+    image = (image_u8_t) {
+        .width = width,
+        .height = height,
+        .channels = channels,
+        .data = data
+    };
+
+cleanup:
+    stbi__cleanup_jpeg(jpeg);
+    free(jpeg);
+    return image;
+}
+
+
+// Decodes an encoded image held in memory straight to the size it will be
+// printed at. JPEGs are decoded at the smallest DCT scale that still covers
+// the character grid; everything else is fully decoded by stb_image first.
+image_t load_resized_from_memory(const unsigned char* buffer, size_t length, const char* name,
+                                 size_t max_width, size_t max_height, double character_ratio, size_t n_threads) {
+    int full_width, full_height, full_channels;
+    if (!stbi_info_from_memory(buffer, (int) length, &full_width, &full_height, &full_channels)) {
+        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", name, stbi_failure_reason());
+        return (image_t) {0};
+    }
+
+    size_t width, height;
+    get_resized_dimensions((size_t) full_width, (size_t) full_height, max_width, max_height, character_ratio, &width, &height);
+
+    image_u8_t original = {0};
+    int is_jpeg = length > 2 && buffer[0] == 0xFF && buffer[1] == 0xD8;
+    if (is_jpeg) {
+        // Keep at least two reduced pixels per output cell so the box
+        // average isn't dominated by where cell edges snap to
+        size_t scale = 8;
+        while (scale > 1 && ((full_width + scale - 1) / scale < 2 * width || (full_height + scale - 1) / scale < 2 * height))
+            scale /= 2;
+
+        if (scale > 1)
+            original = load_jpeg_scaled(buffer, length, scale);
+    }
+
+    if (!original.data) {
+        int channels;
+        original.data = stbi_load_from_memory(buffer, (int) length, &full_width, &full_height, &channels, 0);
+        original.width = (size_t) full_width;
+        original.height = (size_t) full_height;
+        original.channels = (size_t) channels;
+    }
+
+    if (!original.data) {
+        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", name, stbi_failure_reason());
+        return (image_t) {0};
+    }
+
+    image_t resized = make_resampled_u8(&original, width, height, n_threads);
+    free_image_u8(&original);
+    return resized;
+}
+
+
+// stb_image callbacks for reading from a stream that may not be seekable
+static int read_stream(void* user, char* data, int size) {
+    return (int) fread(data, 1, (size_t) size, (FILE*) user);
+}
+
+static void skip_stream(void* user, int n) {
+    char discard[4096];
+    while (n > 0) {
+        size_t count = fread(discard, 1, n < (int) sizeof(discard) ? (size_t) n : sizeof(discard), (FILE*) user);
+        if (!count)
+            break;
+        n -= (int) count;
+    }
+}
+
+static int eof_stream(void* user) {
+    return feof((FILE*) user);
+}
+
+
+// Decodes straight from a stream such as a pipe, without reading the whole
+// file into memory first. Reduced-scale JPEG decoding needs the whole file,
+// so it isn't used here.
+image_t load_resized_from_stream(FILE* file, const char* name,
+                                 size_t max_width, size_t max_height, double character_ratio, size_t n_threads) {
+    stbi_io_callbacks callbacks = {read_stream, skip_stream, eof_stream};
+    int width, height, channels;
+    unsigned char* data = stbi_load_from_callbacks(&callbacks, file, &width, &height, &channels, 0);
+    if (!data) {
+        fprintf(stderr, "Error: Failed to load image '%s': %s!\n", name, stbi_failure_reason());
+        return (image_t) {0};
+    }
+
+    image_u8_t original = {(size_t) width, (size_t) height, (size_t) channels, data};
+    size_t out_width, out_height;
+    get_resized_dimensions(original.width, original.height, max_width, max_height, character_ratio, &out_width, &out_height);
+
+    image_t resized = make_resampled_u8(&original, out_width, out_height, n_threads);
+    free_image_u8(&original);
+    return resized;
+}
+
+
+// Loads an image file, or stdin if the path is "-", resized to the character grid
+image_t load_resized(const char* file_path, size_t max_width, size_t max_height, double character_ratio, size_t n_threads) {
+    if (!strcmp(file_path, "-")) {
+        #ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+        #endif
+        return load_resized_from_stream(stdin, "stdin", max_width, max_height, character_ratio, n_threads);
+    }
+
+    file_map_t file = map_file(file_path);
+    if (!file.data) {
+        fprintf(stderr, "Error: Failed to load image '%s': can't read file!\n", file_path);
+        return (image_t) {0};
+    }
+
+    image_t resized = load_resized_from_memory(file.data, file.length, file_path, max_width, max_height, character_ratio, n_threads);
+    unmap_file(&file);
+    return resized;
+}
+
+
+// Decodes every frame of an animated GIF, composited onto the previous ones
+animation_t load_animation(const char* file_path) {
+    file_map_t file = map_file(file_path);
+    if (!file.data) {
+        fprintf(stderr, "Error: Failed to load animation '%s': can't read file!\n", file_path);
+        return (animation_t) {0};
+    }
+
+    int* delays = NULL;
+    int width, height, n_frames, channels;
+    unsigned char* data = stbi_load_gif_from_memory(file.data, (int) file.length, &delays,
+        &width, &height, &n_frames, &channels, 4);
+    unmap_file(&file);
+
+    if (!data) {
+        fprintf(stderr, "Error: Failed to load animation '%s': %s!\n", file_path, stbi_failure_reason());
+        return (animation_t) {0};
+    }
+
+    return (animation_t) {
+        .width = (size_t) width,
+        .height = (size_t) height,
+        .channels = 4,
+        .n_frames = (size_t) n_frames,
+        .data = data,
+        .delays = delays
+    };
+}
+
+
+void free_animation(animation_t* animation) {
+    if (animation) {
+        stbi_image_free(animation->data);
+        stbi_image_free(animation->delays);
+        animation->data = NULL;
+        animation->delays = NULL;
+    }
+}
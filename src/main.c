@@ -1,9 +1,129 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+    #include <io.h>
+    #define open _open
+    #define close _close
+#else
+    #include <unistd.h>
+#endif
 
 #include "../include/image.h"
 #include "../include/print_image.h"
 #include "../include/argparse.h"
+#include "../include/video.h"
+#include "../include/batch.h"
+#include "../include/render_cache.h"
+#include "../include/pacer.h"
+
+
+// Reads and discards `length` bytes. Returns 1 if they were all there.
+static int skip_bytes(FILE* file, size_t length) {
+    unsigned char chunk[1 << 16];
+    while (length > 0) {
+        size_t n = length < sizeof(chunk) ? length : sizeof(chunk);
+        if (fread(chunk, 1, n, file) != n)
+            return 0;
+        length -= n;
+    }
+    return 1;
+}
+
+
+// Renders images from stdin until EOF. Each one is preceded by its length
+// as a 4-byte big-endian integer. Returns 1 if every image was rendered.
+static int print_image_stream(const args_t* args) {
+    #ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+    #endif
+
+    // Only the totals are reported, not every image's output size
+    args_t image_args = *args;
+    image_args.print_stats = 0;
+
+    // Images of the same size reuse all of the scratch memory of the last one
+    render_scratch_t scratch = {0};
+
+    unsigned char* buffer = NULL;
+    size_t capacity = 0, n_images = 0, n_failed = 0;
+    double start = get_seconds();
+
+    unsigned char prefix[4];
+    while (fread(prefix, 1, sizeof(prefix), stdin) == sizeof(prefix)) {
+        size_t length = (size_t) prefix[0] << 24 | (size_t) prefix[1] << 16 | (size_t) prefix[2] << 8 | prefix[3];
+
+        // One buffer is reused for every image in the stream
+        if (length > capacity) {
+            unsigned char* grown = realloc(buffer, length);
+            if (!grown) {
+                // Skip this image's bytes so the rest of the stream still lines up
+                fprintf(stderr, "Error: Failed to allocate memory for image from stream!\n");
+                n_failed++;
+                n_images++;
+                if (!skip_bytes(stdin, length)) {
+                    fprintf(stderr, "Error: Stream ended in the middle of an image!\n");
+                    break;
+                }
+                continue;
+            }
+            buffer = grown;
+            capacity = length;
+        }
+
+        if (fread(buffer, 1, length, stdin) != length) {
+            fprintf(stderr, "Error: Stream ended in the middle of an image!\n");
+            n_failed++;
+            break;
+        }
+
+        image_t resized = load_resized_from_memory(buffer, length, "stdin", args->max_width, args->max_height,
+            args->character_ratio, args->n_threads);
+        if (resized.data) {
+            if (!print_image(&resized, &image_args, &scratch))
+                n_failed++;
+            free_image(&resized);
+        } else {
+            n_failed++;
+        }
+        n_images++;
+    }
+
+    if (args->print_stats) {
+        double seconds = get_seconds() - start;
+        fprintf(stderr, "Stream: %zu images in %.2f s (%.1f images/s), %zu failed\n",
+            n_images, seconds, n_images / seconds, n_failed);
+        print_scratch_stats(&scratch, 1);
+    }
+
+    free_render_scratch(&scratch);
+    free(buffer);
+    return n_failed == 0;
+}
+
+
+// Prints a still image through the render cache, to -o or stdout.
+// Returns 1 if successful.
+static int print_image_cached(const args_t* args) {
+    int fd = STDOUT_FILENO;
+    if (args->output_path) {
+        fd = open(args->output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "Error: Failed to open output file '%s'!\n", args->output_path);
+            return 0;
+        }
+    }
+
+    frame_t frame = {0};
+    int was_cached;
+    int success = render_file_cached(args->file_path, args, &frame, NULL, fd, &was_cached);
+    free_frame(&frame);
+
+    if (fd != STDOUT_FILENO)
+        close(fd);
+    return success;
+}
 
 
 int main(int argc, char* argv[]) {
@@ -12,28 +132,50 @@ int main(int argc, char* argv[]) {
     if (args.file_path == NULL)
         return 1;
 
-    // Loads image
-    image_t original = load_image(args.file_path);
-    if (!original.data)
-        return 1;
+    // Renders many images to files at once
+    if (args.batch_dir) {
+        int success = run_batch(&args);
+        free(args.input_paths);
+        return success ? 0 : 1;
+    }
+    if (args.n_inputs > 1)
+        fprintf(stderr, "Warning: Ignoring extra paths, use --batch to render several images\n");
+    free(args.input_paths);
 
-    // Resizes image
-    image_t resized = make_resized(&original, args.max_width, args.max_height, args.character_ratio);
-    if (!resized.data) {
-        free_image(&original);
-        return 1;
+    // Only single still images are written to a file
+    if (args.output_path && (args.use_stream || args.use_rainbow_colors || is_video(args.file_path))) {
+        fprintf(stderr, "Warning: Ignoring -o, animations and streams are written to stdout\n");
+        args.output_path = NULL;
+        args.output_format = OUTPUT_ANSI;
     }
+
+    // Long-lived processes can render a whole stream of images
+    if (args.use_stream)
+        return print_image_stream(&args) ? 0 : 1;
+
+    // Animated GIFs and Y4M video are played back frame by frame
+    if (!args.use_rainbow_colors && is_video(args.file_path))
+        return play_video(&args) ? 0 : 1;
+
+    // Repeated renderings of a file are served from disk without decoding it
+    if (args.use_cache && !args.use_rainbow_colors && strcmp(args.file_path, "-"))
+        return print_image_cached(&args) ? 0 : 1;
+
+    // Loads and resizes image; JPEGs are decoded at reduced scale when possible
+    image_t resized = load_resized(args.file_path, args.max_width, args.max_height, args.character_ratio, args.n_threads);
+    if (!resized.data)
+        return 1;
     
     //print image or rainbow animation
+    int success = 1;
     if (!args.use_rainbow_colors) {
-        print_image(&resized, args.edge_threshold, args.use_retro_colors);
+        success = print_image(&resized, &args, NULL);
     } else {
-        print_rainbow_image(&resized, args.edge_threshold, args.use_retro_colors);
+        print_rainbow_image(&resized, &args);
     }
     
     
-    free_image(&original);
     free_image(&resized);
 
-    return 0;
+    return success ? 0 : 1;
 }
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#ifdef _WIN32
+    #include <windows.h>
+    #include <conio.h>
+#else
+    #include <unistd.h>
+    #include <poll.h>
+#endif
+
+#include "../include/pacer.h"
+
+
+// Seconds on a monotonic clock, for pacing and for timing work
+double get_seconds(void) {
+#ifdef _WIN32
+    return (double) GetTickCount64() * 1e-3;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+
+pacer_t make_pacer(double fps) {
+    pacer_t pacer = {0};
+    pacer.period = 1.0 / fps;
+    pacer.deadline = pacer.woke_at = get_seconds();
+    pacer.watch_stdin = 1;
+    return pacer;
+}
+
+
+void free_pacer(pacer_t* pacer) {
+    free(pacer->intervals);
+    free(pacer->render_times);
+    pacer->intervals = pacer->render_times = NULL;
+    pacer->n_samples = pacer->capacity = 0;
+}
+
+
+// Records that a frame just went out, and how long it took since waking up
+void pacer_frame_shown(pacer_t* pacer) {
+    double now = get_seconds();
+
+    if (pacer->n_frames > 0) {
+        if (pacer->n_samples == pacer->capacity) {
+            size_t capacity = pacer->capacity ? pacer->capacity * 2 : 256;
+            double* intervals = realloc(pacer->intervals, sizeof(double) * capacity);
+            if (intervals)
+                pacer->intervals = intervals;
+            double* render_times = realloc(pacer->render_times, sizeof(double) * capacity);
+            if (render_times)
+                pacer->render_times = render_times;
+            if (intervals && render_times)
+                pacer->capacity = capacity;
+        }
+        if (pacer->n_samples < pacer->capacity) {
+            pacer->intervals[pacer->n_samples] = now - pacer->last_shown;
+            pacer->render_times[pacer->n_samples] = now - pacer->woke_at;
+            pacer->n_samples++;
+        }
+    }
+
+    pacer->last_shown = now;
+    pacer->n_frames++;
+}
+
+
+#ifndef _WIN32
+// Reads one key if stdin has one within `timeout` ms. Returns 1 if it did.
+static int poll_key(pacer_t* pacer, int timeout, char* key) {
+    if (!pacer->watch_stdin) {
+        if (timeout > 0) {
+            struct timespec ts = {timeout / 1000, (long) (timeout % 1000) * 1000000L};
+            nanosleep(&ts, NULL);
+        }
+        return 0;
+    }
+
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    int result = poll(&fd, 1, timeout);
+    if (result <= 0)
+        return 0;
+
+    // Stdin was closed or hit EOF, so stop watching it
+    if (read(STDIN_FILENO, key, 1) != 1) {
+        pacer->watch_stdin = 0;
+        return 0;
+    }
+    return 1;
+}
+#endif
+
+
+static int is_quit_key(char key) {
+    return key == 'q' || key == 'Q';
+}
+
+
+// Waits until the next frame is due, skipping deadlines that have already
+// passed. Returns 1 early if q was pressed, storing it in `key`. Other keys
+// are read and ignored, and the wait goes on to the same deadline.
+int pacer_wait(pacer_t* pacer, char* key) {
+    double now = get_seconds();
+
+    pacer->deadline += pacer->period;
+    while (pacer->deadline <= now) {
+        pacer->deadline += pacer->period;
+        pacer->n_dropped++;
+    }
+
+    int quit = 0;
+#ifdef _WIN32
+    while (!quit && (now = get_seconds()) < pacer->deadline) {
+        if (_kbhit()) {
+            *key = (char) _getch();
+            quit = is_quit_key(*key);
+        } else {
+            Sleep(1);
+        }
+    }
+#else
+    // Poll for keys with millisecond resolution, then sleep out the rest
+    while (!quit && (now = get_seconds()) < pacer->deadline) {
+        int timeout = (int) ((pacer->deadline - now) * 1000.0);
+        if (timeout > 0) {
+            quit = poll_key(pacer, timeout, key) && is_quit_key(*key);
+            continue;
+        }
+
+        struct timespec deadline;
+        deadline.tv_sec = (time_t) pacer->deadline;
+        deadline.tv_nsec = (long) ((pacer->deadline - (double) deadline.tv_sec) * 1e9);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+            ;
+    }
+    while (!quit && poll_key(pacer, 0, key))
+        quit = is_quit_key(*key);
+#endif
+
+    pacer->woke_at = get_seconds();
+    return quit;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+
+// Sorts the samples in place and returns the given percentile
+static double get_percentile(double* samples, size_t n, double percentile) {
+    qsort(samples, n, sizeof(double), compare_doubles);
+    size_t index = (size_t) (percentile / 100.0 * (double) (n - 1) + 0.5);
+    return samples[index];
+}
+
+
+void print_pacer_stats(pacer_t* pacer) {
+    fprintf(stderr, "Pacing: %zu frames shown, %zu dropped, target %.2f ms/frame\n",
+        pacer->n_frames, pacer->n_dropped, pacer->period * 1e3);
+    if (pacer->n_samples == 0)
+        return;
+
+    double* intervals = pacer->intervals;
+    double* render_times = pacer->render_times;
+    size_t n = pacer->n_samples;
+    fprintf(stderr, "Frame interval: p50 %.2f ms, p99 %.2f ms\n",
+        get_percentile(intervals, n, 50) * 1e3, get_percentile(intervals, n, 99) * 1e3);
+    fprintf(stderr, "Render time: p50 %.2f ms, p99 %.2f ms\n",
+        get_percentile(render_times, n, 50) * 1e3, get_percentile(render_times, n, 99) * 1e3);
+}
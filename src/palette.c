@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
+
+#include "../include/palette.h"
+
+// Lookup tables are indexed by the top LUT_BITS of each channel
+#define LUT_BITS 5
+#define LUT_SIZE (1 << LUT_BITS)
+#define LUT_SHIFT (8 - LUT_BITS)
+
+// xterm's 6x6x6 color cube starts at index 16, its 24 grays at 232
+#define CUBE_START 16
+#define GRAY_START 232
+#define N_GRAYS 24
+
+static const int cube_levels[6] = {0, 95, 135, 175, 215, 255};
+
+// xterm's default 16 colors: 30-37 and their bright 90-97 versions
+static const unsigned char ansi_16_colors[16][3] = {
+    {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+    {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+    {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+};
+
+static unsigned char lut_256[LUT_SIZE * LUT_SIZE * LUT_SIZE];
+static unsigned char lut_16[LUT_SIZE * LUT_SIZE * LUT_SIZE];
+
+
+static int square_distance(int r1, int g1, int b1, int r2, int g2, int b2) {
+    return (r1 - r2) * (r1 - r2) + (g1 - g2) * (g1 - g2) + (b1 - b2) * (b1 - b2);
+}
+
+
+static int get_nearest_cube_level(int value) {
+    int nearest = 0;
+    for (int i = 1; i < 6; i++) {
+        if (abs(cube_levels[i] - value) < abs(cube_levels[nearest] - value))
+            nearest = i;
+    }
+    return nearest;
+}
+
+
+// The cube's channels are independent, so its nearest color is found one
+// channel at a time and only has to be weighed against the nearest gray
+static int find_nearest_256(int r, int g, int b) {
+    int cube_r = get_nearest_cube_level(r);
+    int cube_g = get_nearest_cube_level(g);
+    int cube_b = get_nearest_cube_level(b);
+    int cube_distance = square_distance(r, g, b, cube_levels[cube_r], cube_levels[cube_g], cube_levels[cube_b]);
+
+    int gray = ((r + g + b) / 3 - 3) / 10;
+    if (gray < 0)
+        gray = 0;
+    if (gray >= N_GRAYS)
+        gray = N_GRAYS - 1;
+    int gray_value = 8 + gray * 10;
+    int gray_distance = square_distance(r, g, b, gray_value, gray_value, gray_value);
+
+    if (gray_distance < cube_distance)
+        return GRAY_START + gray;
+    return CUBE_START + cube_r * 36 + cube_g * 6 + cube_b;
+}
+
+
+static int find_nearest_16(int r, int g, int b) {
+    int nearest = 0, nearest_distance = -1;
+    for (int i = 0; i < 16; i++) {
+        const unsigned char* color = ansi_16_colors[i];
+        int distance = square_distance(r, g, b, color[0], color[1], color[2]);
+        if (nearest_distance < 0 || distance < nearest_distance) {
+            nearest = i;
+            nearest_distance = distance;
+        }
+    }
+    return nearest;
+}
+
+
+// Matches the center of every LUT cell against the palettes once, so
+// rendering is a single table lookup per cell
+static void build_luts(void) {
+    for (int r = 0; r < LUT_SIZE; r++) {
+        for (int g = 0; g < LUT_SIZE; g++) {
+            for (int b = 0; b < LUT_SIZE; b++) {
+                int center_r = (r << LUT_SHIFT) + (1 << LUT_SHIFT) / 2;
+                int center_g = (g << LUT_SHIFT) + (1 << LUT_SHIFT) / 2;
+                int center_b = (b << LUT_SHIFT) + (1 << LUT_SHIFT) / 2;
+                size_t index = ((size_t) r * LUT_SIZE + (size_t) g) * LUT_SIZE + (size_t) b;
+
+                lut_256[index] = (unsigned char) find_nearest_256(center_r, center_g, center_b);
+                lut_16[index] = (unsigned char) find_nearest_16(center_r, center_g, center_b);
+            }
+        }
+    }
+}
+
+
+#ifndef _WIN32
+    static pthread_once_t luts_once = PTHREAD_ONCE_INIT;
+    #define init_luts() pthread_once(&luts_once, build_luts)
+#else
+    // Rendering is single-threaded on Windows
+    static int luts_built = 0;
+    #define init_luts() do { if (!luts_built) { build_luts(); luts_built = 1; } } while (0)
+#endif
+
+
+// Nearest palette entry to an RGB color in [0, 255]; the xterm index for
+// 256 colors, or 0-15 for 16 colors
+int get_palette_index(color_depth_t depth, int r, int g, int b) {
+    init_luts();
+
+    size_t index = (((size_t) r >> LUT_SHIFT) * LUT_SIZE + ((size_t) g >> LUT_SHIFT)) * LUT_SIZE + ((size_t) b >> LUT_SHIFT);
+    return depth == COLORS_16 ? lut_16[index] : lut_256[index];
+}
+
+
+// RGB of a palette entry, e.g. to show it in HTML output
+void get_palette_color(color_depth_t depth, int index, int* out_r, int* out_g, int* out_b) {
+    if (depth == COLORS_16 || index < CUBE_START) {
+        const unsigned char* color = ansi_16_colors[index & 15];
+        *out_r = color[0], *out_g = color[1], *out_b = color[2];
+    } else if (index >= GRAY_START) {
+        *out_r = *out_g = *out_b = 8 + (index - GRAY_START) * 10;
+    } else {
+        index -= CUBE_START;
+        *out_r = cube_levels[index / 36];
+        *out_g = cube_levels[index / 6 % 6];
+        *out_b = cube_levels[index % 6];
+    }
+}
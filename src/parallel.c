@@ -0,0 +1,182 @@
+#include <stdio.h>
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
+
+#include "../include/parallel.h"
+
+#define MAX_THREADS 256
+
+typedef struct {
+    band_func_t func;
+    void* context;
+    size_t begin, end, band;
+} band_t;
+
+
+// Never more bands than rows, and always at least one
+size_t get_band_count(size_t n_rows, size_t n_threads) {
+    if (n_threads > MAX_THREADS)
+        n_threads = MAX_THREADS;
+    if (n_threads > n_rows)
+        n_threads = n_rows;
+    return n_threads ? n_threads : 1;
+}
+
+
+static void* run_band(void* argument) {
+    band_t* band = argument;
+    band->func(band->context, band->begin, band->end, band->band);
+    return NULL;
+}
+
+
+// Splits n_rows into contiguous bands and runs func on each, one per thread.
+// The calling thread takes the first band. Returns once all bands are done.
+void run_bands(size_t n_rows, size_t n_threads, band_func_t func, void* context) {
+    size_t n_bands = get_band_count(n_rows, n_threads);
+    band_t bands[MAX_THREADS];
+
+    for (size_t b = 0; b < n_bands; b++) {
+        bands[b] = (band_t) {
+            .func = func,
+            .context = context,
+            .begin = b * n_rows / n_bands,
+            .end = (b + 1) * n_rows / n_bands,
+            .band = b
+        };
+    }
+
+#ifdef _WIN32
+    for (size_t b = 0; b < n_bands; b++) {
+        run_band(&bands[b]);
+    }
+#else
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+
+    for (size_t b = 1; b < n_bands; b++) {
+        started[b] = pthread_create(&threads[b], NULL, run_band, &bands[b]) == 0;
+        if (!started[b])
+            run_band(&bands[b]); // Fall back to doing it here
+    }
+
+    run_band(&bands[0]);
+
+    for (size_t b = 1; b < n_bands; b++) {
+        if (started[b])
+            pthread_join(threads[b], NULL);
+    }
+#endif
+}
+
+
+// A worker's share of the jobs. Others steal from its back once theirs runs out.
+typedef struct {
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+    size_t next, end;
+} job_queue_t;
+
+typedef struct {
+    job_func_t func;
+    void* context;
+    job_queue_t* queues;
+    size_t n_workers;
+} job_pool_t;
+
+
+static void lock_queue(job_queue_t* queue) {
+#ifndef _WIN32
+    pthread_mutex_lock(&queue->lock);
+#else
+    (void) queue;
+#endif
+}
+
+
+static void unlock_queue(job_queue_t* queue) {
+#ifndef _WIN32
+    pthread_mutex_unlock(&queue->lock);
+#else
+    (void) queue;
+#endif
+}
+
+
+// Takes the next job from the front of a queue. Returns 1 if there was one.
+static int take_job(job_queue_t* queue, size_t* job) {
+    lock_queue(queue);
+    int has_job = queue->next < queue->end;
+    if (has_job)
+        *job = queue->next++;
+    unlock_queue(queue);
+    return has_job;
+}
+
+
+// Moves the back half of the victim's remaining jobs to the (empty) thief
+static int steal_jobs(job_queue_t* victim, job_queue_t* thief) {
+    lock_queue(victim);
+    size_t remaining = victim->end - victim->next;
+    size_t middle = victim->end - (remaining + 1) / 2;
+    size_t end = victim->end;
+    victim->end = middle;
+    unlock_queue(victim);
+
+    if (!remaining)
+        return 0;
+
+    lock_queue(thief);
+    thief->next = middle;
+    thief->end = end;
+    unlock_queue(thief);
+    return 1;
+}
+
+
+static void run_worker(void* context, size_t begin, size_t end, size_t band) {
+    job_pool_t* pool = context;
+    job_queue_t* own = &pool->queues[band];
+    (void) begin, (void) end;
+
+    while (1) {
+        size_t job;
+        if (take_job(own, &job)) {
+            pool->func(pool->context, job, band);
+            continue;
+        }
+
+        int stole = 0;
+        for (size_t k = 1; k < pool->n_workers && !stole; k++)
+            stole = steal_jobs(&pool->queues[(band + k) % pool->n_workers], own);
+        if (!stole)
+            return;
+    }
+}
+
+
+// Runs func on jobs [0, n_jobs) across a pool of threads. Each thread starts
+// with an even share in order and steals from the others when it runs out,
+// so uneven jobs still keep every thread busy. Returns once all are done.
+void run_jobs(size_t n_jobs, size_t n_threads, job_func_t func, void* context) {
+    size_t n_workers = get_band_count(n_jobs, n_threads);
+    job_queue_t queues[MAX_THREADS];
+
+    for (size_t w = 0; w < n_workers; w++) {
+#ifndef _WIN32
+        pthread_mutex_init(&queues[w].lock, NULL);
+#endif
+        queues[w].next = w * n_jobs / n_workers;
+        queues[w].end = (w + 1) * n_jobs / n_workers;
+    }
+
+    job_pool_t pool = {func, context, queues, n_workers};
+    run_bands(n_workers, n_workers, run_worker, &pool);
+
+#ifndef _WIN32
+    for (size_t w = 0; w < n_workers; w++)
+        pthread_mutex_destroy(&queues[w].lock);
+#endif
+}
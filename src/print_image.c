@@ -1,26 +1,100 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <fcntl.h>
 #ifdef _WIN32
     #include <windows.h>
     #include <conio.h>
-    #define s_sleep(x) Sleep(x * 1000)
+    #include <io.h>
+    #define open _open
+    #define close _close
 #else
     #include <unistd.h>
     #include <termios.h>
-    #define s_sleep(x) usleep(x * 1000)
 #endif
 
 #include "../include/image.h"
+#include "../include/color.h"
+#include "../include/frame.h"
+#include "../include/parallel.h"
+#include "../include/pacer.h"
+#include "../include/palette.h"
+#include "../include/glyphs.h"
 #include "../include/print_image.h"
 
 // Characters to print
 #define VALUE_CHARS " .-=+*x#$&X@"
 #define N_VALUES (sizeof(VALUE_CHARS) - 1) // Exclude null
-#define SLEEP_TIME 0.1
 
 // Color ANSI codes
 #define RESET "\x1b[0m"
+#define MAX_CELL_BYTES 20 // "\x1b[38;2;255;255;255m" plus character
+#define MAX_HTML_CELL_BYTES 40 // "</span><span style=\"color:#rrggbb\">&amp;"
+#define MAX_BLOCK_CELL_BYTES 41 // Foreground and background escapes plus a 3-byte glyph
+#define MAX_HTML_BLOCK_CELL_BYTES 63 // "</span><span style=\"color:#rrggbb;background:#rrggbb\">" plus glyph
+
+// UTF-8 block elements for half-block rendering
+#define UPPER_HALF_BLOCK "\xe2\x96\x80"
+#define LOWER_HALF_BLOCK "\xe2\x96\x84"
+#define FULL_BLOCK "\xe2\x96\x88"
+
+// Braille cells are 2 dots wide and 4 tall, U+2800 plus one bit per dot
+#define BRAILLE_WIDTH 2
+#define BRAILLE_HEIGHT 4
+#define MAX_BRAILLE_CELL_BYTES 22 // Foreground escape plus a 3-byte glyph
+#define MAX_HTML_BRAILLE_CELL_BYTES 38 // "</span><span style=\"color:#rrggbb\">" plus glyph
+
+// UTF-8 encoding of U+2800 + n for every dot pattern n
+#define BRAILLE(n) {0xe2, 0xa0 + ((n) >> 6), 0x80 + ((n) & 0x3f)}
+#define BRAILLE_4(n) BRAILLE(n), BRAILLE((n) + 1), BRAILLE((n) + 2), BRAILLE((n) + 3)
+#define BRAILLE_16(n) BRAILLE_4(n), BRAILLE_4((n) + 4), BRAILLE_4((n) + 8), BRAILLE_4((n) + 12)
+#define BRAILLE_64(n) BRAILLE_16(n), BRAILLE_16((n) + 16), BRAILLE_16((n) + 32), BRAILLE_16((n) + 48)
+static const unsigned char braille_utf8[256][3] = {
+    BRAILLE_64(0), BRAILLE_64(64), BRAILLE_64(128), BRAILLE_64(192)
+};
+
+// Bit of each dot, by row then column: dots 1-3 and 4-6 run down the two
+// columns, and dots 7 and 8 were added below them
+static const unsigned char braille_bits[BRAILLE_HEIGHT][BRAILLE_WIDTH] = {
+    {0x01, 0x08},
+    {0x02, 0x10},
+    {0x04, 0x20},
+    {0x40, 0x80}
+};
+
+// Ordered dither thresholds, so flat areas still show their brightness as
+// how many dots are set, from 0 to 8
+static const double braille_thresholds[BRAILLE_HEIGHT][BRAILLE_WIDTH] = {
+    {0.5 / 8, 4.5 / 8},
+    {6.5 / 8, 2.5 / 8},
+    {1.5 / 8, 5.5 / 8},
+    {7.5 / 8, 3.5 / 8}
+};
+
+// Below this spread of squared brightness a 4x8 block is too flat to have a
+// shape, so it gets a character by brightness instead
+#define SHAPE_MIN_CONTRAST 0.25
+
+// HTML output is a standalone page with the grid in a <pre>
+#define HTML_HEADER "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n" \
+    "<style>body { background: #000; } pre { font-family: monospace; line-height: 1; }</style>\n" \
+    "</head>\n<body>\n<pre>\n"
+#define HTML_FOOTER "</pre>\n</body>\n</html>\n"
+
+// Rainbow animation: 2° hue steps repeat every 180 frames. Retro hues walk
+// down by 40° until they fall below 60° (at most 8 frames), then cycle every 3.
+#define RAINBOW_PERIOD 180
+#define RAINBOW_RETRO_PERIOD 3
+#define RAINBOW_RETRO_WARMUP 8
+#define RAINBOW_CACHE_BYTES ((size_t) 64 << 20)
+#define RAINBOW_FPS 20.0
+#define RAINBOW_RETRO_FPS 1.0
+
+// Edge orientation bin boundaries
+#define TAN_22_5 0.41421356237309503
+#define TAN_67_5 2.414213562373095
 
 #ifndef _WIN32
     //these functions are used to allow for non blocking scan (used for quiting rainbow mode)
@@ -50,87 +124,6 @@
 #endif
 
 
-double* get_max(double* a, double* b, double* c) {
-    if ((*a >= *b) && (*a >= *c)) {
-        return a;
-    } else if (*b >= *c) {
-        return b;
-    } else {
-        return c;
-    }
-}
-
-double* get_min(double* a, double* b, double* c) {
-    if ((*a <= *b) && (*a <= *c)) {
-        return a;
-    } else if (*b <= *c) {
-        return b;
-    } else {
-        return c;
-    }
-}
-
-
-hsv_t rgb_to_hsv(double red, double green, double blue) {
-    hsv_t hsv;
-
-    double* max = get_max(&red, &green, &blue);
-    double* min = get_min(&red, &green, &blue);
-
-    hsv.value = *max;
-    double chroma = hsv.value - *min;
-
-    // Calculate saturation
-    if (fabs(hsv.value) < 1e-4) {
-        hsv.saturation = 0.0;
-    } else {
-        hsv.saturation = chroma / hsv.value;
-    }
-
-    // Calculate hue
-    if (chroma < 1e-4) {
-        hsv.hue = 0.0;
-    } else if (max == &red) {
-        hsv.hue = 60.0 * fmod((green - blue) / chroma, 6.0);
-        if (hsv.hue < 0.0) hsv.hue += 360.0;
-    } else if (max == &green) {
-        hsv.hue = 60.0 * (2.0 + (blue - red) / chroma);
-    } else {
-        hsv.hue = 60.0 * (4.0 + (red - green) / chroma);
-    }
-
-    return hsv;
-}
-
-
-void hsv_to_rgb(const hsv_t* hsv, double* r, double* g, double* b) {
-    double c = hsv->value * hsv->saturation;
-    double h_prime = hsv->hue / 60.0;
-    double x = c * (1.0 - fabs(fmod(h_prime, 2.0) - 1.0));
-
-    double r1, g1, b1;
-
-    if (h_prime >= 0.0 && h_prime < 1.0) {
-        r1 = c; g1 = x; b1 = 0.0;
-    } else if (h_prime >= 1.0 && h_prime < 2.0) {
-        r1 = x; g1 = c; b1 = 0.0;
-    } else if (h_prime >= 2.0 && h_prime < 3.0) {
-        r1 = 0.0; g1 = c; b1 = x;
-    } else if (h_prime >= 3.0 && h_prime < 4.0) {
-        r1 = 0.0; g1 = x; b1 = c;
-    } else if (h_prime >= 4.0 && h_prime < 5.0) {
-        r1 = x; g1 = 0.0; b1 = c;
-    } else {
-        r1 = c; g1 = 0.0; b1 = x;
-    }
-
-    double m = hsv->value - c;
-    *r = r1 + m;
-    *g = g1 + m;
-    *b = b1 + m;
-}
-
-
 void get_retro_rgb(const hsv_t* hsv, int* out_r, int* out_g, int* out_b) {
     // For retro colors: quantize hue and saturation for 8-color palette
     hsv_t quantized_hsv = *hsv;
@@ -189,26 +182,182 @@ char get_sobel_angle_char(double sobel_angle) {
 }
 
 
-void print_image(image_t* image, double edge_threshold, int use_retro_colors) {
-    image_t grayscale = make_grayscale(image);
-    double* sobel_x = calloc(grayscale.width * grayscale.height, sizeof(*sobel_x));
-    double* sobel_y = calloc(grayscale.width * grayscale.height, sizeof(*sobel_y));
-    if (!sobel_x || !sobel_y)
-        fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
+// Same bins as get_sobel_angle_char(atan2(sy, sx) * 180 / pi), but found by
+// comparing |sy| / |sx| against tan(22.5) and tan(67.5) and checking signs.
+// Ties go the same way the angle comparisons send them.
+char get_sobel_edge_char(double sx, double sy) {
+    double ax = fabs(sx), ay = fabs(sy);
+    int same_sign = (sx > 0.0) == (sy > 0.0);
 
-    if (edge_threshold < 4.0)
-        get_sobel(&grayscale, sobel_x, sobel_y);
+    // Within 22.5 degrees of horizontal, including no gradient at all
+    if (ay == 0.0 || ay < TAN_22_5 * ax)
+        return '|';
 
-    for (size_t y = 0; y < image->height; y++) {
-        for (size_t x = 0; x < image->width; x++) {
-            double* pixel = get_pixel(image, x, y);
+    // Within 22.5 degrees of vertical; 112.5 and -67.5 count as vertical
+    if (ay > TAN_67_5 * ax || (ay == TAN_67_5 * ax && !same_sign))
+        return '_';
 
-            size_t index = y * image->width + x;
-            double sx = sobel_x[index];
-            double sy = sobel_y[index];
+    return same_sign ? '\\' : '/';
+}
+
+
+// Fused, separable Sobel filter for row y of a grayscale image. Writes the edge
+// character for each column, or 0 where the gradient is under the threshold.
+// Border pixels have zero gradient, as with get_sobel.
+void get_edge_chars(image_t* grayscale, size_t y, double edge_threshold, char* out) {
+    size_t width = grayscale->width;
+    double square_threshold = edge_threshold * edge_threshold;
+    char border = (0.0 >= square_threshold) ? get_sobel_edge_char(0.0, 0.0) : 0;
+
+    if (y == 0 || y + 1 >= grayscale->height || width < 3) {
+        memset(out, border, width);
+        return;
+    }
+
+    const double* above = &grayscale->data[(y - 1) * width];
+    const double* row = above + width;
+    const double* below = row + width;
+
+    // Vertical [1 2 1] and [1 0 -1] passes for the columns left of and at x
+    double smooth_left = above[0] + 2.0 * row[0] + below[0];
+    double diff_left = above[0] - below[0];
+    double smooth_mid = above[1] + 2.0 * row[1] + below[1];
+    double diff_mid = above[1] - below[1];
+
+    out[0] = out[width - 1] = border;
+    for (size_t x = 1; x + 1 < width; x++) {
+        double smooth_right = above[x + 1] + 2.0 * row[x + 1] + below[x + 1];
+        double diff_right = above[x + 1] - below[x + 1];
+
+        // Horizontal [-1 0 1] and [1 2 1] passes finish Gx and Gy
+        double sx = smooth_right - smooth_left;
+        double sy = diff_left + 2.0 * diff_mid + diff_right;
+
+        if (sx * sx + sy * sy >= square_threshold)
+            out[x] = get_sobel_edge_char(sx, sy);
+        else
+            out[x] = 0;
+
+        smooth_left = smooth_mid, diff_left = diff_mid;
+        smooth_mid = smooth_right, diff_mid = diff_right;
+    }
+}
 
-            double square_sobel_magnitude = sx * sx + sy * sy;
-            double sobel_angle = atan2(sy, sx) * 180. / M_PI;
+
+// Reports how many bytes color coalescing kept off the wire
+void print_output_stats(size_t total_bytes, size_t saved_bytes, size_t n_frames) {
+    fprintf(stderr, "Output: %zu bytes/frame, %zu bytes/frame saved by color coalescing (%.1f%%)\n",
+        total_bytes / n_frames, saved_bytes / n_frames,
+        100.0 * saved_bytes / (total_bytes + saved_bytes));
+}
+
+
+typedef struct {
+    image_t* image;
+    image_t* grayscale;
+    double edge_threshold;
+    int use_retro_colors;
+    output_format_t format;
+    color_depth_t color_depth;
+    frame_t* frames;
+    arena_t* arenas; // One per band, for its row buffers
+} render_context_t;
+
+
+// Sets the foreground color with the escape codes for the color depth
+static void set_cell_color(frame_t* frame, color_depth_t color_depth, int r, int g, int b) {
+    switch (color_depth) {
+        case COLORS_256:
+            frame_set_fg_256(frame, get_palette_index(COLORS_256, r, g, b));
+            break;
+        case COLORS_16:
+            frame_set_fg_16(frame, get_palette_index(COLORS_16, r, g, b));
+            break;
+        default:
+            // Use 24-bit truecolor ANSI escape code
+            frame_set_fg_color(frame, r, g, b);
+            break;
+    }
+}
+
+
+// Encodes one cell of the glyph/color grid in the output format
+static void append_cell(frame_t* frame, const render_context_t* render, int r, int g, int b, char c) {
+    switch (render->format) {
+        case OUTPUT_TEXT:
+            frame_append_char(frame, c);
+            break;
+        case OUTPUT_HTML:
+            // Pages show the same palette colors a terminal would
+            if (render->color_depth != COLORS_TRUECOLOR) {
+                int index = get_palette_index(render->color_depth, r, g, b);
+                get_palette_color(render->color_depth, index, &r, &g, &b);
+            }
+            frame_set_html_color(frame, r, g, b);
+            frame_append_html_char(frame, c);
+            break;
+        default:
+            set_cell_color(frame, render->color_depth, r, g, b);
+            frame_append_char(frame, c);
+            break;
+    }
+}
+
+
+// Finds edges and formats rows [begin, end) into the band's own frame
+static void render_rows(void* context, size_t begin, size_t end, size_t band) {
+    render_context_t* render = context;
+    image_t* image = render->image;
+    int use_retro_colors = render->use_retro_colors;
+    frame_t* frame = &render->frames[band];
+
+    arena_t* arena = &render->arenas[band];
+
+    // Edge characters for the current row, if edges are enabled
+    char* edges = NULL;
+    if (render->edge_threshold < 4.0) {
+        edges = arena_alloc(arena, image->width);
+        if (!edges)
+            fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
+    }
+
+    // Color rows are converted a whole row at a time by the SIMD kernels, into
+    // one plane per HSV component. The full brightness colors reuse the hues
+    // and saturations with a plane of ones for the values.
+    int is_color = image->channels > 2;
+    hsv_planes_t row_hsvs = {0};
+    double* ones = NULL;
+    double* row_rgb = NULL;
+    if (is_color) {
+        row_hsvs.hues = arena_alloc(arena, sizeof(double) * image->width);
+        row_hsvs.saturations = arena_alloc(arena, sizeof(double) * image->width);
+        row_hsvs.values = arena_alloc(arena, sizeof(double) * image->width);
+        ones = arena_alloc(arena, sizeof(double) * image->width);
+        row_rgb = arena_alloc(arena, sizeof(double) * 3 * image->width);
+        if (!row_hsvs.hues || !row_hsvs.saturations || !row_hsvs.values || !ones || !row_rgb) {
+            fprintf(stderr, "Error: Failed to allocate memory for color conversion!\n");
+            return;
+        }
+        for (size_t x = 0; x < image->width; x++)
+            ones[x] = 1.0;
+    }
+    hsv_planes_t bright_hsvs = {row_hsvs.hues, row_hsvs.saturations, ones};
+
+    for (size_t y = begin; y < end; y++) {
+        if (edges)
+            get_edge_chars(render->grayscale, y, render->edge_threshold, edges);
+
+        if (is_color) {
+            rgb_to_hsv_planes(get_pixel(image, 0, y), image->channels, row_hsvs, image->width);
+
+            // Set value to full brightness for both modes
+            // Character choice controls apparent brightness, not color value
+            if (!use_retro_colors)
+                hsv_to_rgb_planes(bright_hsvs, row_rgb, image->width);
+        }
+
+        for (size_t x = 0; x < image->width; x++) {
+            double* pixel = get_pixel(image, x, y);
 
             char ascii_char;
 
@@ -221,155 +370,833 @@ void print_image(image_t* image, double edge_threshold, int use_retro_colors) {
                 r = g = b = (int)(pixel[0] * 255);
             } else {
                 // RGB image
-                hsv_t hsv = rgb_to_hsv(pixel[0], pixel[1], pixel[2]);
-
+                hsv_t hsv = {row_hsvs.hues[x], row_hsvs.saturations[x], row_hsvs.values[x]};
                 grayscale = calculate_grayscale_from_hsv(&hsv);
 
-                // Set value to full brightness for both modes
-                // Character choice controls apparent brightness, not color value
-                hsv.value = 1.0;
-
                 if (use_retro_colors) {
                     // Retro mode: quantize hue to 60° and saturation to 0% or 100%
                     get_retro_rgb(&hsv, &r, &g, &b);
                 } else {
-                    // Truecolor mode: convert HSV back to RGB with full brightness
-                    double r_d, g_d, b_d;
-                    hsv_to_rgb(&hsv, &r_d, &g_d, &b_d);
-                    r = (int)(r_d * 255);
-                    g = (int)(g_d * 255);
-                    b = (int)(b_d * 255);
+                    // Truecolor mode: HSV was converted back to RGB with full brightness
+                    r = (int)(row_rgb[x * 3] * 255);
+                    g = (int)(row_rgb[x * 3 + 1] * 255);
+                    b = (int)(row_rgb[x * 3 + 2] * 255);
                 }
             }
 
             ascii_char = get_ascii_char(grayscale);
 
             // If edge
-            if (square_sobel_magnitude >= edge_threshold * edge_threshold)
-                ascii_char = get_sobel_angle_char(sobel_angle);
+            if (edges && edges[x])
+                ascii_char = edges[x];
 
-            // Use 24-bit truecolor ANSI escape code
-            printf("\x1b[38;2;%d;%d;%dm%c", r, g, b, ascii_char);
+            append_cell(frame, render, r, g, b, ascii_char);
         }
-        printf("\n");
+        frame_append_char(frame, '\n');
     }
 
-    printf("%s", RESET);
-
-    free(sobel_x);
-    free(sobel_y);
-    free_image(&grayscale);
+    // Every band's HTML stands on its own, so bands can be joined in any order
+    if (render->format == OUTPUT_HTML)
+        frame_close_html_span(frame);
 }
 
-void print_rainbow_image(image_t* image, double edge_threshold, int use_retro_colors) {
-    char true = 1;
-    char* ascii = (char*)malloc(sizeof(char) * image->height * image->width);
-    hsv_t* hsvs = (hsv_t*)malloc(sizeof(hsv_t) * image->height * image->width);
 
-    if (!ascii || !hsvs)
-        fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
+// Color of one pixel, and the key it is compared by: the palette entry when
+// a palette is used, since neighbouring colors often share one
+typedef struct {
+    int r, g, b;
+    int key;
+} block_color_t;
 
-    //get the regular ascii and hsv values
-    get_ascii_and_color(ascii, hsvs, image, edge_threshold, use_retro_colors);
 
-    #ifndef _WIN32
-        set_raw_mode();
-    #endif
+static block_color_t get_block_color(const render_context_t* render, size_t x, size_t y) {
+    double* pixel = get_pixel(render->image, x, y);
+    block_color_t color;
+    if (render->image->channels <= 2) {
+        color.r = color.g = color.b = (int)(pixel[0] * 255);
+    } else {
+        color.r = (int)(pixel[0] * 255);
+        color.g = (int)(pixel[1] * 255);
+        color.b = (int)(pixel[2] * 255);
+    }
 
-    char key_press = 0;
-    //loop until killed by terminal
-    while(true) {
-        //now print the image with correct colors
-        for (size_t y = 0; y < image->height; y++) {
-            for(size_t x = 0; x < image->width; x++) {
-                //get the ascii character and hsv value
-                hsv_t hsv = hsvs[y * image->width + x];
+    if (render->color_depth == COLORS_TRUECOLOR) {
+        color.key = color.r << 16 | color.g << 8 | color.b;
+    } else {
+        color.key = get_palette_index(render->color_depth, color.r, color.g, color.b);
+        get_palette_color(render->color_depth, color.key, &color.r, &color.g, &color.b);
+    }
+    return color;
+}
 
-                double r_d, g_d, b_d;
-                hsv_to_rgb(&hsv, &r_d, &g_d, &b_d);
 
-                //get the rgb values and ascii character
-                int r = (int)(r_d * 255);
-                int g = (int)(g_d * 255);
-                int b = (int)(b_d * 255);
-                char ascii_char = ascii[y * image->width + x];
+static void set_block_color(frame_t* frame, color_depth_t color_depth, int is_background, block_color_t color) {
+    if (color_depth == COLORS_256) {
+        if (is_background)
+            frame_set_bg_256(frame, color.key);
+        else
+            frame_set_fg_256(frame, color.key);
+    } else if (color_depth == COLORS_16) {
+        if (is_background)
+            frame_set_bg_16(frame, color.key);
+        else
+            frame_set_fg_16(frame, color.key);
+    } else if (is_background) {
+        frame_set_bg_color(frame, color.r, color.g, color.b);
+    } else {
+        frame_set_fg_color(frame, color.r, color.g, color.b);
+    }
+}
 
-                //print the character
-                printf("\x1b[38;2;%d;%d;%dm%c", r, g, b, ascii_char);
 
-                //now peform a hue rotation on the hsv value and store it for next time
-                if(use_retro_colors) {
-                    hsv.hue += 20.0;
-                    if (hsv.hue >= 60.0)
-                        hsv.hue -= 60.0;
+// Formats cell rows [begin, end) into the band's own frame. Each cell shows
+// two pixel rows: the upper one in the foreground color of an upper half
+// block and the lower one in the background color.
+static void render_half_block_rows(void* context, size_t begin, size_t end, size_t band) {
+    render_context_t* render = context;
+    image_t* image = render->image;
+    color_depth_t color_depth = render->color_depth;
+    frame_t* frame = &render->frames[band];
 
-                    hsvs[y * image->width + x] = hsv;
+    //keys of the colors currently set, or -1
+    int fg = -1, bg = -1;
 
+    for (size_t row = begin; row < end; row++) {
+        size_t y = row * 2;
+        int has_lower = y + 1 < image->height;
+
+        for (size_t x = 0; x < image->width; x++) {
+            block_color_t upper = get_block_color(render, x, y);
+            block_color_t lower = has_lower ? get_block_color(render, x, y + 1) : upper;
+
+            if (render->format == OUTPUT_TEXT) {
+                frame_append_string(frame, UPPER_HALF_BLOCK);
+            } else if (render->format == OUTPUT_HTML) {
+                if (has_lower)
+                    frame_set_html_colors(frame, upper.r, upper.g, upper.b, lower.r, lower.g, lower.b);
+                else
+                    frame_set_html_color(frame, upper.r, upper.g, upper.b);
+                frame_append_string(frame, UPPER_HALF_BLOCK);
+            } else if (!has_lower) {
+                // The last of an odd number of pixel rows has the default background below it
+                frame_reset_bg(frame);
+                set_block_color(frame, color_depth, 0, upper);
+                fg = upper.key, bg = -1;
+                frame_append_string(frame, UPPER_HALF_BLOCK);
+            } else if (upper.key == lower.key) {
+                // A single color can come from either layer, so reuse whichever is set
+                if (upper.key == fg && upper.key != bg) {
+                    frame_append_string(frame, FULL_BLOCK);
                 } else {
-                    hsv.hue += 2.0;
-                    if (hsv.hue >= 360.0)
-                        hsv.hue -= 360.0;
+                    set_block_color(frame, color_depth, 1, upper);
+                    bg = upper.key;
+                    frame_append_char(frame, ' ');
+                }
+            } else {
+                // Flipping to a lower half block swaps the layers, so pick the
+                // glyph that leaves more of the current colors as they are
+                int upper_matches = (upper.key == fg) + (lower.key == bg);
+                int lower_matches = (lower.key == fg) + (upper.key == bg);
+                int use_lower = lower_matches > upper_matches;
+                block_color_t foreground = use_lower ? lower : upper;
+                block_color_t background = use_lower ? upper : lower;
+
+                set_block_color(frame, color_depth, 0, foreground);
+                set_block_color(frame, color_depth, 1, background);
+                fg = foreground.key, bg = background.key;
+                frame_append_string(frame, use_lower ? LOWER_HALF_BLOCK : UPPER_HALF_BLOCK);
+            }
+        }
+
+        if (render->format == OUTPUT_ANSI) {
+            frame_reset_bg(frame);
+            bg = -1;
+        }
+        frame_append_char(frame, '\n');
+    }
+
+    if (render->format == OUTPUT_HTML)
+        frame_close_html_span(frame);
+}
+
+
+// Color of a cell drawn from several pixels, given the sum of their colors.
+// The glyph carries the brightness, so the average is shown at full value the
+// same way ascii characters are.
+static void get_average_color(const render_context_t* render, const double* sum, size_t n_pixels, int* r, int* g, int* b) {
+    hsv_t hsv = rgb_to_hsv(sum[0] / n_pixels, sum[1] / n_pixels, sum[2] / n_pixels);
+    if (render->use_retro_colors) {
+        get_retro_rgb(&hsv, r, g, b);
+    } else {
+        double bright_r, bright_g, bright_b;
+        hsv.value = 1.0;
+        hsv_to_rgb(&hsv, &bright_r, &bright_g, &bright_b);
+        *r = (int)(bright_r * 255);
+        *g = (int)(bright_g * 255);
+        *b = (int)(bright_b * 255);
+    }
+}
 
-                    hsvs[y * image->width + x] = hsv;
+
+// Formats cell rows [begin, end) into the band's own frame. Each cell turns
+// a 2x4 block of pixels into Braille dots, in the block's average color.
+static void render_braille_rows(void* context, size_t begin, size_t end, size_t band) {
+    render_context_t* render = context;
+    image_t* image = render->image;
+    const double* luminance = render->grayscale->data;
+    frame_t* frame = &render->frames[band];
+    size_t n_columns = (image->width + BRAILLE_WIDTH - 1) / BRAILLE_WIDTH;
+
+    for (size_t row = begin; row < end; row++) {
+        size_t top = row * BRAILLE_HEIGHT;
+
+        for (size_t column = 0; column < n_columns; column++) {
+            size_t left = column * BRAILLE_WIDTH;
+            unsigned int dots = 0;
+            double sum[3] = {0.0, 0.0, 0.0};
+            size_t n_pixels = 0;
+
+            for (size_t dy = 0; dy < BRAILLE_HEIGHT && top + dy < image->height; dy++) {
+                for (size_t dx = 0; dx < BRAILLE_WIDTH && left + dx < image->width; dx++) {
+                    size_t x = left + dx, y = top + dy;
+                    // Squared for contrast, like calculate_grayscale_from_hsv
+                    double brightness = luminance[y * image->width + x];
+                    if (brightness * brightness > braille_thresholds[dy][dx])
+                        dots |= braille_bits[dy][dx];
+
+                    const double* pixel = get_pixel(image, x, y);
+                    for (size_t c = 0; c < 3; c++)
+                        sum[c] += pixel[image->channels > 2 ? c : 0];
+                    n_pixels++;
                 }
+            }
+
+            int r, g, b;
+            get_average_color(render, sum, n_pixels, &r, &g, &b);
+
+            if (render->format == OUTPUT_HTML) {
+                if (render->color_depth != COLORS_TRUECOLOR)
+                    get_palette_color(render->color_depth, get_palette_index(render->color_depth, r, g, b), &r, &g, &b);
+                frame_set_html_color(frame, r, g, b);
+            } else if (render->format == OUTPUT_ANSI) {
+                set_cell_color(frame, render->color_depth, r, g, b);
+            }
 
+            if (reserve_frame(frame, 3)) {
+                memcpy(frame->data + frame->length, braille_utf8[dots], 3);
+                frame->length += 3;
             }
-            printf("\n");
         }
+        frame_append_char(frame, '\n');
+    }
 
-        printf("\x1b[0mPress q to quit\n");
+    if (render->format == OUTPUT_HTML)
+        frame_close_html_span(frame);
+}
 
-        printf("\x1b[%luA", image->height+2);
-        if(use_retro_colors) {
-            s_sleep(1000);
-        } else {
-            s_sleep(50);
+
+// Formats cell rows [begin, end) into the band's own frame. Each 4x8 block
+// of pixels is split into light and dark at its middle brightness, and the
+// ascii character whose ink covers the light part best is shown.
+static void render_shape_rows(void* context, size_t begin, size_t end, size_t band) {
+    render_context_t* render = context;
+    image_t* image = render->image;
+    const double* luminance = render->grayscale->data;
+    frame_t* frame = &render->frames[band];
+    size_t n_columns = (image->width + GLYPH_WIDTH - 1) / GLYPH_WIDTH;
+
+    // A row of cells is matched at once; flat cells already have a character
+    arena_t* arena = &render->arenas[band];
+    uint32_t* patterns = arena_alloc(arena, sizeof(uint32_t) * n_columns);
+    char* shape_chars = arena_alloc(arena, n_columns);
+    char* flat_chars = arena_alloc(arena, n_columns);
+    int* colors = arena_alloc(arena, sizeof(int) * 3 * n_columns);
+    if (!patterns || !shape_chars || !flat_chars || !colors) {
+        fprintf(stderr, "Error: Failed to allocate memory for shape matching!\n");
+        return;
+    }
+
+    for (size_t row = begin; row < end; row++) {
+        size_t top = row * GLYPH_HEIGHT;
+
+        for (size_t column = 0; column < n_columns; column++) {
+            size_t left = column * GLYPH_WIDTH;
+            // Squared for contrast, like calculate_grayscale_from_hsv. Blocks
+            // past the image's edge repeat its last pixels, so the edge isn't
+            // taken for a shape.
+            double samples[GLYPH_HEIGHT * GLYPH_WIDTH];
+            double sum[3] = {0.0, 0.0, 0.0};
+
+            for (size_t dy = 0; dy < GLYPH_HEIGHT; dy++) {
+                size_t y = top + dy < image->height ? top + dy : image->height - 1;
+                for (size_t dx = 0; dx < GLYPH_WIDTH; dx++) {
+                    size_t x = left + dx < image->width ? left + dx : image->width - 1;
+                    double brightness = luminance[y * image->width + x];
+                    samples[dy * GLYPH_WIDTH + dx] = brightness * brightness;
+
+                    const double* pixel = get_pixel(image, x, y);
+                    for (size_t c = 0; c < 3; c++)
+                        sum[c] += pixel[image->channels > 2 ? c : 0];
+                }
+            }
+
+            double low = samples[0], high = samples[0], total = 0.0;
+            for (size_t i = 0; i < GLYPH_HEIGHT * GLYPH_WIDTH; i++) {
+                low = samples[i] < low ? samples[i] : low;
+                high = samples[i] > high ? samples[i] : high;
+                total += samples[i];
+            }
+
+            uint32_t pattern = 0;
+            double middle = (low + high) / 2.0;
+            for (size_t i = 0; i < GLYPH_HEIGHT * GLYPH_WIDTH; i++) {
+                if (samples[i] > middle)
+                    pattern |= (uint32_t) 1 << i;
+            }
+            patterns[column] = pattern;
+
+            flat_chars[column] = 0;
+            if (high - low < SHAPE_MIN_CONTRAST)
+                flat_chars[column] = get_ascii_char(total / (GLYPH_HEIGHT * GLYPH_WIDTH));
+
+            get_average_color(render, sum, GLYPH_HEIGHT * GLYPH_WIDTH, &colors[column * 3], &colors[column * 3 + 1], &colors[column * 3 + 2]);
+        }
+
+        match_glyph_row(patterns, shape_chars, n_columns);
+
+        for (size_t column = 0; column < n_columns; column++) {
+            const int* color = &colors[column * 3];
+            char c = flat_chars[column] ? flat_chars[column] : shape_chars[column];
+            append_cell(frame, render, color[0], color[1], color[2], c);
+        }
+        frame_append_char(frame, '\n');
+    }
+
+    if (render->format == OUTPUT_HTML)
+        frame_close_html_span(frame);
+}
+
+
+// Number of terminal rows the image takes up
+size_t get_cell_rows(const image_t* image, const args_t* args) {
+    switch (args->render_mode) {
+        case RENDER_HALF_BLOCKS: return (image->height + 1) / 2;
+        case RENDER_BRAILLE: return (image->height + BRAILLE_HEIGHT - 1) / BRAILLE_HEIGHT;
+        case RENDER_SHAPES: return (image->height + GLYPH_HEIGHT - 1) / GLYPH_HEIGHT;
+        default: return image->height;
+    }
+}
+
+
+static size_t get_cell_columns(const image_t* image, const args_t* args) {
+    if (args->render_mode == RENDER_BRAILLE)
+        return (image->width + BRAILLE_WIDTH - 1) / BRAILLE_WIDTH;
+    if (args->render_mode == RENDER_SHAPES)
+        return (image->width + GLYPH_WIDTH - 1) / GLYPH_WIDTH;
+    return image->width;
+}
+
+
+static size_t get_max_cell_bytes(const args_t* args) {
+    switch (args->render_mode) {
+        case RENDER_HALF_BLOCKS:
+            return args->output_format == OUTPUT_TEXT ? 3
+                : args->output_format == OUTPUT_HTML ? MAX_HTML_BLOCK_CELL_BYTES : MAX_BLOCK_CELL_BYTES;
+        case RENDER_BRAILLE:
+            return args->output_format == OUTPUT_TEXT ? 3
+                : args->output_format == OUTPUT_HTML ? MAX_HTML_BRAILLE_CELL_BYTES : MAX_BRAILLE_CELL_BYTES;
+        default:
+            return args->output_format == OUTPUT_TEXT ? 1
+                : args->output_format == OUTPUT_HTML ? MAX_HTML_CELL_BYTES : MAX_CELL_BYTES;
+    }
+}
+
+
+// Makes room for n_bands arenas and frames. Returns 1 if successful.
+static int reserve_scratch_bands(render_scratch_t* scratch, size_t n_bands) {
+    if (n_bands <= scratch->n_bands)
+        return 1;
+
+    arena_t* arenas = realloc(scratch->band_arenas, n_bands * sizeof(*arenas));
+    if (arenas)
+        scratch->band_arenas = arenas;
+    frame_t* frames = realloc(scratch->band_frames, n_bands * sizeof(*frames));
+    if (frames)
+        scratch->band_frames = frames;
+    if (!arenas || !frames)
+        return 0;
+
+    scratch->n_allocations += 2;
+    for (size_t b = scratch->n_bands; b < n_bands; b++) {
+        scratch->band_arenas[b] = (arena_t) {0};
+        scratch->band_frames[b] = (frame_t) {0};
+    }
+    scratch->n_bands = n_bands;
+    return 1;
+}
+
+
+static size_t count_scratch_allocations(const render_scratch_t* scratch) {
+    size_t n_allocations = scratch->n_allocations + scratch->planes.n_allocations;
+    for (size_t b = 0; b < scratch->n_bands; b++)
+        n_allocations += scratch->band_arenas[b].n_allocations;
+    return n_allocations;
+}
+
+
+void free_render_scratch(render_scratch_t* scratch) {
+    free_arena(&scratch->planes);
+    for (size_t b = 0; b < scratch->n_bands; b++) {
+        free_arena(&scratch->band_arenas[b]);
+        free_frame(&scratch->band_frames[b]);
+    }
+    free(scratch->band_arenas);
+    free(scratch->band_frames);
+    *scratch = (render_scratch_t) {0};
+}
+
+
+// Reports how much scratch memory rendering used, and how many allocations
+// it took for the first render and for all the ones after it
+void print_scratch_stats(const render_scratch_t* scratches, size_t n_scratches) {
+    size_t peak_bytes = 0, n_renders = 0, n_first_renders = 0, first_allocations = 0, n_allocations = 0;
+    for (size_t i = 0; i < n_scratches; i++) {
+        const render_scratch_t* scratch = &scratches[i];
+        if (!scratch->n_renders)
+            continue;
+
+        peak_bytes += scratch->planes.peak;
+        for (size_t b = 0; b < scratch->n_bands; b++)
+            peak_bytes += scratch->band_arenas[b].peak + scratch->band_frames[b].capacity;
+        n_renders += scratch->n_renders;
+        n_first_renders++;
+        first_allocations += scratch->first_allocations;
+        n_allocations += count_scratch_allocations(scratch);
+    }
+
+    if (n_renders)
+        fprintf(stderr, "Scratch: %zu KiB peak, %zu allocations for the first render, %zu for the %zu after\n",
+            (peak_bytes + 1023) / 1024, first_allocations, n_allocations - first_allocations, n_renders - n_first_renders);
+}
+
+
+// Formats the image into one frame per band of rows, splitting the work
+// across threads. The frames belong to the scratch. Returns the number of
+// bands, or 0 on failure.
+static size_t render_bands(image_t* image, const args_t* args, render_scratch_t* scratch) {
+    size_t n_rows = get_cell_rows(image, args);
+    size_t n_bands = get_band_count(n_rows, args->n_threads);
+    if (!reserve_scratch_bands(scratch, n_bands)) {
+        fprintf(stderr, "Error: Failed to allocate memory for frame buffers!\n");
+        return 0;
+    }
+
+    // Half blocks show colors only, so they need no luminance plane
+    image_t grayscale = {0};
+    if (args->render_mode != RENDER_HALF_BLOCKS) {
+        grayscale = (image_t) {image->width, image->height, 1,
+            arena_alloc(&scratch->planes, sizeof(double) * image->width * image->height)};
+        if (!grayscale.data) {
+            fprintf(stderr, "Error: Failed to allocate memory for grayscale image!\n");
+            return 0;
+        }
+        get_grayscale(image, grayscale.data);
+    }
+
+    size_t cell_bytes = get_max_cell_bytes(args);
+    for (size_t b = 0; b < n_bands; b++) {
+        frame_t* frame = &scratch->band_frames[b];
+        size_t band_height = (b + 1) * n_rows / n_bands - b * n_rows / n_bands;
+        size_t capacity = frame->capacity;
+
+        clear_frame(frame);
+        frame->saved_bytes = 0;
+        reserve_frame(frame, band_height * (get_cell_columns(image, args) * cell_bytes + 1) + sizeof(RESET));
+        scratch->n_allocations += frame->capacity != capacity;
+    }
+
+    render_context_t context = {
+        .image = image,
+        .grayscale = &grayscale,
+        .edge_threshold = args->edge_threshold,
+        .use_retro_colors = args->use_retro_colors,
+        .format = args->output_format,
+        .color_depth = args->color_depth,
+        .frames = scratch->band_frames,
+        .arenas = scratch->band_arenas
+    };
+    band_func_t render_func = render_rows;
+    if (args->render_mode == RENDER_HALF_BLOCKS)
+        render_func = render_half_block_rows;
+    else if (args->render_mode == RENDER_BRAILLE)
+        render_func = render_braille_rows;
+    else if (args->render_mode == RENDER_SHAPES)
+        render_func = render_shape_rows;
+    run_bands(n_rows, n_bands, render_func, &context);
+
+    // Planes and row buffers are only needed while the bands run. Resetting
+    // now also merges anything that overflowed, so the next render fits.
+    reset_arena(&scratch->planes);
+    for (size_t b = 0; b < n_bands; b++)
+        reset_arena(&scratch->band_arenas[b]);
+
+    if (++scratch->n_renders == 1)
+        scratch->first_allocations = count_scratch_allocations(scratch);
+    return n_bands;
+}
+
+
+// Writes the whole document for the image to args->output_path at once
+static int write_image_file(image_t* image, const args_t* args, render_scratch_t* scratch) {
+    frame_t frame = {0};
+    render_document(image, args, &frame, scratch);
+
+    int success = 0;
+    int fd = open(args->output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open output file '%s'!\n", args->output_path);
+    } else {
+        success = write_frame(&frame, fd);
+        close(fd);
+    }
+
+    if (args->print_stats && success)
+        print_output_stats(frame.length, frame.saved_bytes, 1);
+
+    free_frame(&frame);
+    return success;
+}
+
+
+// Prints the image to stdout, or to the -o file. Returns 1 if successful.
+int print_image(image_t* image, const args_t* args, render_scratch_t* scratch) {
+    render_scratch_t own_scratch = {0};
+    if (!scratch)
+        scratch = &own_scratch;
+
+    if (args->output_path) {
+        int success = write_image_file(image, args, scratch);
+        free_render_scratch(&own_scratch);
+        return success;
+    }
+
+    // Each band of rows is formatted into its own frame, then written in order
+    size_t n_bands = render_bands(image, args, scratch);
+    frame_t* frames = scratch->band_frames;
+
+    int success = n_bands > 0;
+    size_t total_bytes = 0, saved_bytes = 0;
+    for (size_t b = 0; b < n_bands; b++) {
+        if (b == n_bands - 1)
+            frame_reset_colors(&frames[b]);
+        success &= write_frame(&frames[b], STDOUT_FILENO);
+
+        total_bytes += frames[b].length;
+        saved_bytes += frames[b].saved_bytes;
+    }
+
+    if (args->print_stats && n_bands)
+        print_output_stats(total_bytes, saved_bytes, 1);
+
+    free_render_scratch(&own_scratch);
+    return success;
+}
+
+
+// Appends the formatted image to `frame`, leaving colors set as they are
+void render_image(image_t* image, const args_t* args, frame_t* frame, render_scratch_t* scratch) {
+    render_scratch_t own_scratch = {0};
+    if (!scratch)
+        scratch = &own_scratch;
+
+    size_t n_bands = render_bands(image, args, scratch);
+    frame_t* frames = scratch->band_frames;
+
+    for (size_t b = 0; b < n_bands; b++) {
+        if (reserve_frame(frame, frames[b].length)) {
+            memcpy(frame->data + frame->length, frames[b].data, frames[b].length);
+            frame->length += frames[b].length;
         }
+        frame->saved_bytes += frames[b].saved_bytes;
+    }
+
+    free_render_scratch(&own_scratch);
+}
+
+
+// Appends the image as a complete file in args->output_format
+void render_document(image_t* image, const args_t* args, frame_t* frame, render_scratch_t* scratch) {
+    if (args->output_format == OUTPUT_HTML)
+        frame_append_string(frame, HTML_HEADER);
+
+    render_image(image, args, frame, scratch);
+
+    if (args->output_format == OUTPUT_HTML)
+        frame_append_string(frame, HTML_FOOTER);
+    else if (args->output_format == OUTPUT_ANSI)
+        frame_reset_colors(frame);
+}
+
+// State of the rainbow animation between frames. Every color is shown at full
+// value, so only hues and saturations are kept, each in its own plane; the
+// hue rotation then runs over the hue plane alone.
+typedef struct {
+    char* ascii;
+    double* hues;
+    double* saturations;
+    double* ones; // One row of full values
+    double* row_rgb;
+    uint32_t* shown_colors; // Color currently on screen for each cell, or NULL
+    size_t width;
+    size_t height;
+    int use_retro_colors;
+    color_depth_t color_depth;
+} rainbow_t;
+
+
+// Advances a row of hues by one animation step, wrapping at the limit
+static void rotate_hues(double* hues, size_t n, double step, double limit) {
+    for (size_t i = 0; i < n; i++) {
+        double hue = hues[i] + step;
+        hues[i] = hue >= limit ? hue - limit : hue;
+    }
+}
 
-        if (read(STDIN_FILENO, &key_press, 1) > 0) {
-            if (key_press == 'q' || key_press == 'Q') {
-                break; // Exit the loop
+
+// Formats one animation frame and rotates every hue for the next one. A
+// redraw prints every cell; otherwise only cells whose color changed are
+// printed, with cursor movement in between. Both leave the cursor at the
+// image's top-left corner.
+static void encode_rainbow_frame(frame_t* frame, rainbow_t* rainbow, int redraw) {
+    size_t width = rainbow->width;
+    size_t height = rainbow->height;
+
+    //cursor position relative to the top-left corner of the image
+    size_t row = 0, column = 0;
+
+    clear_frame(frame);
+
+    //now print the image with correct colors
+    for (size_t y = 0; y < height; y++) {
+        //convert the whole row back to rgb at once
+        double* hues = &rainbow->hues[y * width];
+        hsv_planes_t row_hsvs = {hues, &rainbow->saturations[y * width], rainbow->ones};
+        hsv_to_rgb_planes(row_hsvs, rainbow->row_rgb, width);
+
+        //now peform a hue rotation on the row and store it for next time
+        if (rainbow->use_retro_colors)
+            rotate_hues(hues, width, 20.0, 60.0);
+        else
+            rotate_hues(hues, width, 2.0, 360.0);
+
+        for(size_t x = 0; x < width; x++) {
+            size_t index = y * width + x;
+
+            //get the rgb values and ascii character
+            int r = (int)(rainbow->row_rgb[x * 3] * 255);
+            int g = (int)(rainbow->row_rgb[x * 3 + 1] * 255);
+            int b = (int)(rainbow->row_rgb[x * 3 + 2] * 255);
+            char ascii_char = rainbow->ascii[index];
+            uint32_t color = (uint32_t) r << 16 | (uint32_t) g << 8 | (uint32_t) b;
+
+            //with a palette, the cell only changes when its palette entry does
+            if (rainbow->color_depth != COLORS_TRUECOLOR)
+                color = 1u << 24 | (uint32_t) get_palette_index(rainbow->color_depth, r, g, b);
+
+            //print the character, skipping it if it is already on screen
+            if (redraw) {
+                set_cell_color(frame, rainbow->color_depth, r, g, b);
+                frame_append_char(frame, ascii_char);
+            } else if (rainbow->shown_colors[index] != color) {
+                frame_move_cursor(frame, row, column, y, x);
+                set_cell_color(frame, rainbow->color_depth, r, g, b);
+                frame_append_char(frame, ascii_char);
+                row = y, column = x + 1;
+
+                //the cursor doesn't move past the last column of a full-width line
+                if (column == width) {
+                    frame_append_char(frame, '\r');
+                    column = 0;
+                }
             }
+            if (rainbow->shown_colors)
+                rainbow->shown_colors[index] = color;
         }
+        if (redraw)
+            frame_append_char(frame, '\n');
+    }
+
+    frame_reset_colors(frame);
+
+    if (redraw) {
+        frame_append_string(frame, "Press q to quit\n");
+
+        //move cursor back up to the top of the image
+        frame_append_string(frame, "\x1b[");
+        frame_append_uint(frame, height + 1);
+        frame_append_char(frame, 'A');
+    } else {
+        frame_move_cursor(frame, row, column, 0, 0);
+    }
+}
+
+
+void print_rainbow_image(image_t* image, const args_t* args) {
+    int use_retro_colors = args->use_retro_colors;
+    char true = 1;
+    rainbow_t rainbow = {
+        .ascii = (char*)malloc(sizeof(char) * image->height * image->width),
+        .hues = (double*)malloc(sizeof(double) * image->height * image->width),
+        .saturations = (double*)malloc(sizeof(double) * image->height * image->width),
+        .ones = (double*)malloc(sizeof(double) * image->width),
+        .row_rgb = (double*)malloc(sizeof(double) * 3 * image->width),
+        .shown_colors = NULL,
+        .width = image->width,
+        .height = image->height,
+        .use_retro_colors = use_retro_colors,
+        .color_depth = args->color_depth
+    };
+
+    if (!rainbow.ascii || !rainbow.hues || !rainbow.saturations || !rainbow.ones || !rainbow.row_rgb)
+        fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
+    else
+        for (size_t x = 0; x < image->width; x++)
+            rainbow.ones[x] = 1.0;
+
+    //only cells that changed are redrawn unless asked otherwise
+    if (!args->use_full_redraw) {
+        rainbow.shown_colors = (uint32_t*)malloc(sizeof(uint32_t) * image->height * image->width);
+        if (!rainbow.shown_colors)
+            fprintf(stderr, "Error: Failed to allocate memory for frame differences!\n");
     }
 
-    #ifdef _WIN32
-        if (_kbhit()) {
-            char KEY_PRESS = _getch();
+    //get the regular ascii and hsv values
+    get_ascii_and_color(rainbow.ascii, rainbow.hues, rainbow.saturations, image, args->edge_threshold, use_retro_colors);
 
-            if (KEY_PRESS == 'q' || KEY_PRESS == 'Q') {
-                break;
+    #ifndef _WIN32
+        set_raw_mode();
+    #endif
+
+    //one buffer is reused for every frame of the animation
+    frame_t frame = make_frame(image->height * (image->width * MAX_CELL_BYTES + 1) + 64);
+    size_t n_frames = 0, total_bytes = 0, saved_bytes = 0, first_frame_bytes = 0;
+
+    //the hue rotation repeats, so one period of encoded frames is kept and replayed.
+    //differences are relative to the previous frame, so those start a frame later.
+    size_t warmup = use_retro_colors ? RAINBOW_RETRO_WARMUP : 0;
+    if (rainbow.shown_colors)
+        warmup++;
+    size_t period = use_retro_colors ? RAINBOW_RETRO_PERIOD : RAINBOW_PERIOD;
+    frame_t* cached_frames = calloc(period, sizeof(*cached_frames));
+    size_t n_cached = 0;
+
+    //frames are shown on a fixed grid of deadlines, dropping any that are missed
+    double fps = args->fps > 0.0 ? args->fps : use_retro_colors ? RAINBOW_RETRO_FPS : RAINBOW_FPS;
+    pacer_t pacer = make_pacer(fps);
+
+    char key_press = 0;
+    //loop until killed by terminal
+    while(true) {
+        frame_t* current = &frame;
+
+        if (cached_frames && n_cached == period) {
+            current = &cached_frames[(n_frames - warmup) % period];
+        } else {
+            size_t saved_before = frame.saved_bytes;
+            encode_rainbow_frame(&frame, &rainbow, n_frames == 0 || !rainbow.shown_colors);
+            frame.saved_bytes -= saved_before;
+
+            if (cached_frames && n_frames >= warmup) {
+                //give up on caching if a whole period would not fit in the budget
+                if (frame.length > RAINBOW_CACHE_BYTES / period) {
+                    for (size_t i = 0; i < n_cached; i++)
+                        free_frame(&cached_frames[i]);
+                    free(cached_frames);
+                    cached_frames = NULL;
+                } else {
+                    cached_frames[n_cached++] = copy_frame(&frame);
+                }
             }
         }
-    #else
+
+        write_frame(current, STDOUT_FILENO);
+        total_bytes += current->length;
+        saved_bytes += current->saved_bytes;
+        if (n_frames == 0)
+            first_frame_bytes = current->length;
+        n_frames++;
+
+        pacer_frame_shown(&pacer);
+
+        //wait for the next frame's deadline, or until q is pressed
+        if (pacer_wait(&pacer, &key_press))
+            break; // Exit the loop
+    }
+
+    #ifndef _WIN32
         restore_mode();
     #endif
-    free(ascii);
-    free(hsvs);
+    free(rainbow.ascii);
+    free(rainbow.hues);
+    free(rainbow.saturations);
+    free(rainbow.ones);
+    free(rainbow.row_rgb);
+    free(rainbow.shown_colors);
+    if (cached_frames) {
+        for (size_t i = 0; i < n_cached; i++)
+            free_frame(&cached_frames[i]);
+        free(cached_frames);
+    }
     //clear the terminal
     printf("\x1b[2J");
+
+    if (args->print_stats) {
+        print_output_stats(total_bytes, saved_bytes, n_frames);
+        if (n_frames > 1)
+            fprintf(stderr, "Frames: first %zu bytes, then %zu bytes/frame\n",
+                first_frame_bytes, (total_bytes - first_frame_bytes) / (n_frames - 1));
+        print_pacer_stats(&pacer);
+    }
+    free_pacer(&pacer);
+    free_frame(&frame);
 }
 
-void get_ascii_and_color(char* ascii_dest, hsv_t* hsv_dest, image_t* image, double edge_threshold, int use_retro_colors) {
+void get_ascii_and_color(char* ascii_dest, double* hue_dest, double* saturation_dest, image_t* image, double edge_threshold, int use_retro_colors) {
     image_t grayscale = make_grayscale(image);
-    double* sobel_x = calloc(grayscale.width * grayscale.height, sizeof(*sobel_x));
-    double* sobel_y = calloc(grayscale.width * grayscale.height, sizeof(*sobel_y));
-    if (!sobel_x || !sobel_y)
-        fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
 
-    if (edge_threshold < 4.0)
-        get_sobel(&grayscale, sobel_x, sobel_y);
+    // Hues and saturations go straight into their planes; values are only
+    // needed for the characters, one row at a time
+    double* values = NULL;
+    if (image->channels > 2) {
+        values = malloc(sizeof(double) * image->width);
+        if (!values) {
+            fprintf(stderr, "Error: Failed to allocate memory for color conversion!\n");
+            free_image(&grayscale);
+            return;
+        }
+    }
+
+    char* edges = NULL;
+    if (edge_threshold < 4.0) {
+        edges = malloc(image->width);
+        if (!edges)
+            fprintf(stderr, "Error: Failed to allocate memory for edge detection!\n");
+    }
 
     for (size_t y = 0; y < image->height; y++) {
+        if (edges)
+            get_edge_chars(&grayscale, y, edge_threshold, edges);
+
+        size_t row = y * image->width;
+        if (values) {
+            hsv_planes_t row_hsvs = {&hue_dest[row], &saturation_dest[row], values};
+            rgb_to_hsv_planes(get_pixel(image, 0, y), image->channels, row_hsvs, image->width);
+        }
+
         for (size_t x = 0; x < image->width; x++) {
             double* pixel = get_pixel(image, x, y);
 
             size_t index = y * image->width + x;
-            double sx = sobel_x[index];
-            double sy = sobel_y[index];
-
-            double square_sobel_magnitude = sx * sx + sy * sy;
-            double sobel_angle = atan2(sy, sx) * 180. / M_PI;
 
             char ascii_char;
 
@@ -380,7 +1207,7 @@ void get_ascii_and_color(char* ascii_dest, hsv_t* hsv_dest, image_t* image, doub
                 grayscale = pixel[0];
             } else {
                 // RGB image
-                hsv_t hsv = rgb_to_hsv(pixel[0], pixel[1], pixel[2]);
+                hsv_t hsv = {hue_dest[index], saturation_dest[index], values[x]};
 
                 grayscale = calculate_grayscale_from_hsv(&hsv);
 
@@ -389,23 +1216,22 @@ void get_ascii_and_color(char* ascii_dest, hsv_t* hsv_dest, image_t* image, doub
                     int r, g, b = 255;
                     get_retro_rgb(&hsv, &r, &g, &b);
                     hsv = rgb_to_hsv(r, g, b);
+                    hue_dest[index] = hsv.hue;
+                    saturation_dest[index] = hsv.saturation;
                 }
-
-                hsv.value = 1.0;
-                hsv_dest[index] = hsv;
             }
 
             ascii_char = get_ascii_char(grayscale);
 
             // If edge
-            if (square_sobel_magnitude >= edge_threshold * edge_threshold)
-                ascii_char = get_sobel_angle_char(sobel_angle);
+            if (edges && edges[x])
+                ascii_char = edges[x];
 
             ascii_dest[index] = ascii_char;
         }
     }
 
-    free(sobel_x);
-    free(sobel_y);
+    free(edges);
+    free(values);
     free_image(&grayscale);
 }
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <utime.h>
+    #include <pthread.h>
+#endif
+#ifdef __linux__
+    #include <sys/sendfile.h>
+#endif
+
+#include "../include/image.h"
+#include "../include/file_map.h"
+#include "../include/print_image.h"
+#include "../include/render_cache.h"
+
+// Bump whenever the encoded output changes, so stale entries stop matching
+#define CACHE_FORMAT_VERSION 1
+
+// Entry names are two 16-digit hex hashes joined by '-'
+#define CACHE_NAME_LENGTH 33
+#define CACHE_DIR_LENGTH 4096
+#define CACHE_PATH_LENGTH (CACHE_DIR_LENGTH + CACHE_NAME_LENGTH + 2)
+
+// XXH64 primes
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct {
+    char name[CACHE_NAME_LENGTH + 1];
+    size_t size;
+    time_t last_used;
+} cache_entry_t;
+
+// Running total of the cache directory's size, so storing an entry doesn't
+// have to list the whole directory. It is counted once per process and
+// after that only recounted when eviction is due.
+typedef struct {
+    char dir[CACHE_DIR_LENGTH];
+    size_t total_bytes;
+    int is_counted;
+} cache_usage_t;
+
+
+static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+static uint64_t read_u64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+
+static uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME64_2;
+    return rotate_left(accumulator, 31) * PRIME64_1;
+}
+
+
+static uint64_t merge_round(uint64_t hash, uint64_t accumulator) {
+    hash ^= hash_round(0, accumulator);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+
+// XXH64 of the bytes: four independent lanes of 8 bytes each, so it runs at
+// several GB/s and hashing the input costs far less than decoding it.
+// Words are read in native byte order, which is all a local cache needs.
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* p = data;
+    const unsigned char* end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+
+        do {
+            v1 = hash_round(v1, read_u64(p));
+            v2 = hash_round(v2, read_u64(p + 8));
+            v3 = hash_round(v3, read_u64(p + 16));
+            v4 = hash_round(v4, read_u64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    } else {
+        hash = seed + PRIME64_5;
+    }
+
+    hash += (uint64_t) length;
+
+    for (; end - p >= 8; p += 8) {
+        hash ^= hash_round(0, read_u64(p));
+        hash = rotate_left(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        hash ^= (uint64_t) word * PRIME64_1;
+        hash = rotate_left(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= (uint64_t) *p * PRIME64_5;
+        hash = rotate_left(hash, 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+
+// Hashes the input together with every argument that changes the output
+// bytes. The thread count doesn't change what the image looks like, so it
+// isn't part of the key.
+cache_key_t make_cache_key(const unsigned char* data, size_t length, const args_t* args) {
+    uint64_t settings[] = {
+        CACHE_FORMAT_VERSION,
+        (uint64_t) args->max_width,
+        (uint64_t) args->max_height,
+        double_bits(args->character_ratio),
+        double_bits(args->edge_threshold),
+        (uint64_t) args->use_retro_colors,
+        (uint64_t) args->color_depth,
+        (uint64_t) args->render_mode,
+        (uint64_t) args->output_format
+    };
+
+    cache_key_t key = {
+        .content_hash = hash_bytes(data, length, 0),
+        .settings_hash = hash_bytes(settings, sizeof(settings), 0)
+    };
+    return key;
+}
+
+
+#ifndef _WIN32
+
+// Finds the cache directory, creating it if needed: --cache-dir, or else
+// $XDG_CACHE_HOME/ascii-view or ~/.cache/ascii-view. Returns 1 if successful.
+static int get_cache_dir(const args_t* args, char* out, size_t size) {
+    if (args->cache_dir) {
+        snprintf(out, size, "%s", args->cache_dir);
+    } else {
+        const char* xdg_cache = getenv("XDG_CACHE_HOME");
+        const char* home = getenv("HOME");
+        if (xdg_cache && xdg_cache[0]) {
+            snprintf(out, size, "%s", xdg_cache);
+        } else if (home && home[0]) {
+            snprintf(out, size, "%s/.cache", home);
+            mkdir(out, 0755);
+        } else {
+            return 0;
+        }
+        size_t length = strlen(out);
+        snprintf(out + length, size - length, "/ascii-view");
+    }
+
+    if (mkdir(out, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Failed to create cache directory '%s'!\n", out);
+        return 0;
+    }
+    return 1;
+}
+
+
+static void get_entry_path(const char* dir, cache_key_t key, char* out, size_t size) {
+    snprintf(out, size, "%s/%016llx-%016llx", dir,
+        (unsigned long long) key.content_hash, (unsigned long long) key.settings_hash);
+}
+
+
+// Copies `length` bytes from in_fd to out_fd. Linux does it inside the kernel
+// with sendfile; where that isn't supported (e.g. terminals, or other
+// systems) it falls back to reading into a buffer. Returns 1 if successful,
+// 0 if it failed before writing anything, and -1 if out_fd may have been
+// partly written.
+static int copy_fd(int in_fd, int out_fd, size_t length) {
+    size_t copied = 0;
+
+#ifdef __linux__
+    while (copied < length) {
+        ssize_t result = sendfile(out_fd, in_fd, NULL, length - copied);
+        if (result > 0) {
+            copied += (size_t) result;
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else if (result < 0 && copied == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            break;
+        } else {
+            return copied ? -1 : 0;
+        }
+    }
+#endif
+
+    char buffer[1 << 16];
+    while (copied < length) {
+        ssize_t n_read = read(in_fd, buffer, sizeof(buffer));
+        if (n_read < 0 && errno == EINTR)
+            continue;
+        if (n_read <= 0)
+            return copied ? -1 : 0;
+
+        frame_t chunk = {.data = buffer, .length = (size_t) n_read, .capacity = sizeof(buffer)};
+        if (!write_frame(&chunk, out_fd))
+            return -1;
+        copied += (size_t) n_read;
+    }
+
+    return 1;
+}
+
+
+// Writes the cached rendering to fd and marks it as recently used.
+// Returns 1 on a hit, 0 if there is no entry or it couldn't be sent and
+// nothing was written, and -1 if sending failed part way through.
+int send_cached(const args_t* args, cache_key_t key, int fd) {
+    char dir[CACHE_DIR_LENGTH], path[CACHE_PATH_LENGTH];
+    if (!get_cache_dir(args, dir, sizeof(dir)))
+        return 0;
+    get_entry_path(dir, key, path, sizeof(path));
+
+    int in_fd = open(path, O_RDONLY);
+    if (in_fd < 0)
+        return 0;
+
+    int success = 0;
+    struct stat info;
+    if (fstat(in_fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        // Anything still sitting in stdio's buffer has to go out first
+        fflush(stdout);
+        success = copy_fd(in_fd, fd, (size_t) info.st_size);
+    }
+    close(in_fd);
+
+    // Modification time doubles as last use, since atime is often disabled
+    if (success)
+        utime(path, NULL);
+
+    if (success < 0)
+        fprintf(stderr, "Error: Failed to send cache entry '%s'!\n", path);
+    else if (success && args->print_stats)
+        fprintf(stderr, "Cache: hit, %lld bytes sent from %s\n", (long long) info.st_size, path);
+
+    return success;
+}
+
+
+static int compare_last_used(const void* a, const void* b) {
+    const cache_entry_t* entry_a = a;
+    const cache_entry_t* entry_b = b;
+    return (entry_a->last_used > entry_b->last_used) - (entry_a->last_used < entry_b->last_used);
+}
+
+
+// Deletes least recently used entries until the cache fits in max_bytes.
+// Returns the size of what is left.
+static size_t evict_entries(const char* dir, size_t max_bytes) {
+    DIR* handle = opendir(dir);
+    if (!handle)
+        return 0;
+
+    cache_entry_t* entries = NULL;
+    size_t n_entries = 0, capacity = 0, total_bytes = 0;
+    char path[CACHE_PATH_LENGTH];
+
+    struct dirent* dirent;
+    while ((dirent = readdir(handle))) {
+        if (strlen(dirent->d_name) != CACHE_NAME_LENGTH || dirent->d_name[16] != '-')
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, dirent->d_name);
+        struct stat info;
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        if (n_entries == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            cache_entry_t* grown = realloc(entries, sizeof(*entries) * capacity);
+            if (!grown)
+                break;
+            entries = grown;
+        }
+
+        cache_entry_t* entry = &entries[n_entries++];
+        memcpy(entry->name, dirent->d_name, CACHE_NAME_LENGTH + 1);
+        entry->size = (size_t) info.st_size;
+        entry->last_used = info.st_mtime;
+        total_bytes += entry->size;
+    }
+    closedir(handle);
+
+    if (total_bytes > max_bytes) {
+        qsort(entries, n_entries, sizeof(*entries), compare_last_used);
+        for (size_t i = 0; i < n_entries && total_bytes > max_bytes; i++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+            if (unlink(path) == 0 || errno == ENOENT)
+                total_bytes -= entries[i].size;
+        }
+    }
+
+    free(entries);
+    return total_bytes;
+}
+
+
+// Adds a new entry to the cache's running total, and evicts once the total
+// goes over max_bytes. The first call counts the directory instead. Past the
+// limit, eviction goes down to 90% of it, so the next directory listing is
+// only due after that much more has been stored. Batch workers share the
+// total.
+static void add_cache_usage(const char* dir, size_t entry_bytes, size_t max_bytes) {
+    static cache_usage_t usage;
+    static pthread_mutex_t usage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&usage_lock);
+    if (!usage.is_counted || strcmp(usage.dir, dir)) {
+        snprintf(usage.dir, sizeof(usage.dir), "%s", dir);
+        usage.total_bytes = evict_entries(dir, max_bytes);
+        usage.is_counted = 1;
+    } else {
+        usage.total_bytes += entry_bytes;
+        if (usage.total_bytes > max_bytes)
+            usage.total_bytes = evict_entries(dir, max_bytes - max_bytes / 10);
+    }
+    pthread_mutex_unlock(&usage_lock);
+}
+
+
+// Saves a rendering under its key. It is written to a temporary file and
+// renamed into place, so concurrent readers never see a partial entry.
+void store_cached(const args_t* args, cache_key_t key, const frame_t* frame) {
+    char dir[CACHE_DIR_LENGTH], path[CACHE_PATH_LENGTH], temp_path[CACHE_PATH_LENGTH];
+    if (!get_cache_dir(args, dir, sizeof(dir)))
+        return;
+    get_entry_path(dir, key, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s/.tmp-XXXXXX", dir);
+
+    int fd = mkstemp(temp_path);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to create cache entry in '%s'!\n", dir);
+        return;
+    }
+
+    frame_t copy = *frame;
+    int success = write_frame(&copy, fd);
+    close(fd);
+
+    if (!success || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+        return;
+    }
+
+    add_cache_usage(dir, frame->length, args->cache_size << 20);
+}
+
+#else
+
+// The cache relies on POSIX file APIs, so on Windows every lookup misses
+int send_cached(const args_t* args, cache_key_t key, int fd) {
+    (void) args, (void) key, (void) fd;
+    return 0;
+}
+
+
+void store_cached(const args_t* args, cache_key_t key, const frame_t* frame) {
+    (void) args, (void) key, (void) frame;
+}
+
+#endif
+
+
+// Renders a still image file to fd as a complete document, serving it from
+// the cache when the same file was rendered with the same settings before.
+// On a miss the document is formatted into `frame` and stored for next time.
+// Returns 1 if successful.
+int render_file_cached(const char* file_path, const args_t* args, frame_t* frame, render_scratch_t* scratch,
+                       int fd, int* was_cached) {
+    *was_cached = 0;
+
+    file_map_t file = map_file(file_path);
+    if (!file.data) {
+        fprintf(stderr, "Error: Failed to load image '%s': can't read file!\n", file_path);
+        return 0;
+    }
+
+    // Once part of an entry went out, rendering again would append a second
+    // document to the same output
+    cache_key_t key = make_cache_key(file.data, file.length, args);
+    int sent = send_cached(args, key, fd);
+    if (sent) {
+        unmap_file(&file);
+        *was_cached = sent > 0;
+        return sent > 0;
+    }
+
+    image_t resized = load_resized_from_memory(file.data, file.length, file_path,
+        args->max_width, args->max_height, args->character_ratio, args->n_threads);
+    unmap_file(&file);
+    if (!resized.data)
+        return 0;
+
+    clear_frame(frame);
+    frame->saved_bytes = 0;
+    render_document(&resized, args, frame, scratch);
+    free_image(&resized);
+
+    if (!write_frame(frame, fd))
+        return 0;
+
+    if (args->print_stats)
+        print_output_stats(frame->length, frame->saved_bytes, 1);
+
+    store_cached(args, key, frame);
+    return 1;
+}
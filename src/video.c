@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #define STDOUT_FILENO 1
+#else
+    #include <unistd.h>
+    #include <pthread.h>
+#endif
+
+#include "../include/image.h"
+#include "../include/file_map.h"
+#include "../include/frame.h"
+#include "../include/pacer.h"
+#include "../include/print_image.h"
+#include "../include/video.h"
+
+#define VIDEO_QUEUE_SIZE 4
+#define Y4M_MAX_LINE 1024
+
+// Browsers show GIF frames with delays of 10 ms or less for 100 ms instead
+#define GIF_MIN_DELAY 10
+#define GIF_DEFAULT_DELAY 100
+
+typedef enum {
+    VIDEO_GIF,
+    VIDEO_Y4M
+} video_kind_t;
+
+typedef enum {
+    Y4M_420,
+    Y4M_422,
+    Y4M_444,
+    Y4M_MONO
+} y4m_chroma_t;
+
+typedef struct {
+    video_kind_t kind;
+    size_t width;
+    size_t height;
+    size_t out_width;
+    size_t out_height;
+    size_t n_threads;
+
+    // GIF: every frame is decoded up front
+    animation_t animation;
+    size_t next_frame;
+
+    // Y4M: frames are read one at a time
+    FILE* file;
+    y4m_chroma_t chroma;
+    int has_alpha;
+    int full_range;
+    double frame_time;
+    unsigned char* planes;
+    size_t frame_bytes;
+    image_u8_t yuv;
+} video_t;
+
+// A frame resized to the character grid, and how long to show it for
+typedef struct {
+    image_t image;
+    double delay;
+} video_frame_t;
+
+
+// Skips a chain of GIF data sub-blocks, each a length byte and that many
+// bytes, ending at a zero length. Returns the position after it.
+static size_t skip_gif_sub_blocks(const unsigned char* data, size_t length, size_t position) {
+    while (position < length && data[position])
+        position += (size_t) data[position] + 1;
+    return position + 1;
+}
+
+
+// Counts the image descriptors in a GIF up to `limit`, walking the block
+// structure without decoding anything. A truncated or malformed file
+// returns the frames found before the damage.
+static size_t count_gif_frames(const unsigned char* data, size_t length, size_t limit) {
+    // Header and logical screen descriptor, then the global color table
+    if (length < 13)
+        return 0;
+    size_t position = 13;
+    if (data[10] & 0x80)
+        position += (size_t) 3 << ((data[10] & 0x07) + 1);
+
+    size_t n_frames = 0;
+    while (position < length && n_frames < limit) {
+        unsigned char block = data[position];
+        if (block == 0x21) {
+            // Extension: label, then sub-blocks
+            position = skip_gif_sub_blocks(data, length, position + 2);
+        } else if (block == 0x2c) {
+            // Image descriptor, local color table, LZW code size, then sub-blocks
+            if (position + 10 > length)
+                break;
+            unsigned char flags = data[position + 9];
+            position += 10;
+            if (flags & 0x80)
+                position += (size_t) 3 << ((flags & 0x07) + 1);
+            position = skip_gif_sub_blocks(data, length, position + 1);
+            n_frames++;
+        } else {
+            break; // Trailer, or not a block at all
+        }
+    }
+    return n_frames;
+}
+
+
+// Checks for a Y4M signature, or a GIF with more than one frame; a still
+// GIF is an image. For "-", only the first byte of stdin can be peeked at,
+// which is enough to tell "YUV4MPEG2" from image formats.
+int is_video(const char* file_path) {
+    if (!strcmp(file_path, "-")) {
+        int c = getc(stdin);
+        if (c == EOF)
+            return 0;
+        ungetc(c, stdin);
+        return c == 'Y';
+    }
+
+    FILE* file = fopen(file_path, "rb");
+    if (!file)
+        return 0;
+
+    char magic[9] = {0};
+    size_t length = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (length == 9 && !memcmp(magic, "YUV4MPEG2", 9))
+        return 1;
+    if (length < 4 || memcmp(magic, "GIF8", 4))
+        return 0;
+
+    file_map_t gif = map_file(file_path);
+    if (!gif.data)
+        return 0;
+    size_t n_frames = count_gif_frames(gif.data, gif.length, 2);
+    unmap_file(&gif);
+    return n_frames > 1;
+}
+
+
+// Parses the stream header, e.g. "YUV4MPEG2 W640 H480 F30:1 Ip A1:1 C420jpeg"
+static int read_y4m_header(video_t* video) {
+    char line[Y4M_MAX_LINE];
+    if (!fgets(line, sizeof(line), video->file) || strncmp(line, "YUV4MPEG2 ", 10) || !strchr(line, '\n')) {
+        fprintf(stderr, "Error: Input is not a Y4M stream!\n");
+        return 0;
+    }
+
+    long width = 0, height = 0, rate_num = 30, rate_den = 1;
+    video->chroma = Y4M_420;
+
+    for (char* token = strtok(line + 10, " \n"); token; token = strtok(NULL, " \n")) {
+        switch (token[0]) {
+            case 'W':
+                width = strtol(token + 1, NULL, 10);
+                break;
+            case 'H':
+                height = strtol(token + 1, NULL, 10);
+                break;
+            case 'F':
+                if (sscanf(token + 1, "%ld:%ld", &rate_num, &rate_den) != 2 || rate_num <= 0 || rate_den <= 0)
+                    rate_num = 30, rate_den = 1;
+                break;
+            case 'C':
+                if (!strcmp(token + 1, "420") || !strcmp(token + 1, "420jpeg")
+                    || !strcmp(token + 1, "420paldv") || !strcmp(token + 1, "420mpeg2"))
+                    video->chroma = Y4M_420;
+                else if (!strcmp(token + 1, "422"))
+                    video->chroma = Y4M_422;
+                else if (!strcmp(token + 1, "444"))
+                    video->chroma = Y4M_444;
+                else if (!strcmp(token + 1, "444alpha"))
+                    video->chroma = Y4M_444, video->has_alpha = 1;
+                else if (!strcmp(token + 1, "mono"))
+                    video->chroma = Y4M_MONO;
+                else {
+                    fprintf(stderr, "Error: Unsupported Y4M colorspace '%s'!\n", token + 1);
+                    return 0;
+                }
+                break;
+            case 'X':
+                if (!strcmp(token + 1, "COLORRANGE=FULL"))
+                    video->full_range = 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Error: Y4M stream has no frame size!\n");
+        return 0;
+    }
+
+    video->width = (size_t) width;
+    video->height = (size_t) height;
+    video->frame_time = (double) rate_den / (double) rate_num;
+    return 1;
+}
+
+
+static void get_chroma_size(const video_t* video, size_t* width, size_t* height) {
+    switch (video->chroma) {
+        case Y4M_420: *width = (video->width + 1) / 2, *height = (video->height + 1) / 2; break;
+        case Y4M_422: *width = (video->width + 1) / 2, *height = video->height; break;
+        case Y4M_444: *width = video->width, *height = video->height; break;
+        default: *width = *height = 0; break;
+    }
+}
+
+
+static int open_video(video_t* video, const args_t* args) {
+    const char* file_path = args->file_path;
+    video->n_threads = args->n_threads;
+
+    if (!strcmp(file_path, "-")) {
+        #ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+        #endif
+        video->kind = VIDEO_Y4M;
+        video->file = stdin;
+    } else {
+        video->file = fopen(file_path, "rb");
+        if (!video->file) {
+            fprintf(stderr, "Error: Failed to open '%s'!\n", file_path);
+            return 0;
+        }
+
+        char magic[4] = {0};
+        size_t length = fread(magic, 1, sizeof(magic), video->file);
+        rewind(video->file);
+
+        if (length == 4 && !memcmp(magic, "GIF8", 4)) {
+            fclose(video->file);
+            video->file = NULL;
+            video->kind = VIDEO_GIF;
+        } else {
+            video->kind = VIDEO_Y4M;
+        }
+    }
+
+    if (video->kind == VIDEO_GIF) {
+        video->animation = load_animation(file_path);
+        if (!video->animation.data)
+            return 0;
+        video->width = video->animation.width;
+        video->height = video->animation.height;
+    } else {
+        if (!read_y4m_header(video))
+            return 0;
+
+        size_t chroma_width, chroma_height;
+        get_chroma_size(video, &chroma_width, &chroma_height);
+        size_t luma_bytes = video->width * video->height;
+        video->frame_bytes = luma_bytes * (video->has_alpha ? 2 : 1) + 2 * chroma_width * chroma_height;
+
+        video->yuv.width = video->width;
+        video->yuv.height = video->height;
+        // Mono frames stay one gray channel, which every renderer and the
+        // luminance plane read as the pixel's brightness
+        video->yuv.channels = video->chroma == Y4M_MONO ? 1 : 3;
+        video->planes = malloc(video->frame_bytes);
+        video->yuv.data = malloc(luma_bytes * video->yuv.channels);
+        if (!video->planes || !video->yuv.data) {
+            fprintf(stderr, "Error: Failed to allocate memory for video frame!\n");
+            return 0;
+        }
+    }
+
+    get_resized_dimensions(video->width, video->height, args->max_width, args->max_height,
+        args->character_ratio, &video->out_width, &video->out_height);
+    return 1;
+}
+
+
+static void close_video(video_t* video) {
+    free_animation(&video->animation);
+    if (video->file && video->file != stdin)
+        fclose(video->file);
+    free(video->planes);
+    free_image_u8(&video->yuv);
+}
+
+
+// Reads the next Y4M frame and spreads its planes into interleaved samples,
+// repeating each chroma sample over the luma samples it covers
+static int read_y4m_frame(video_t* video) {
+    char line[Y4M_MAX_LINE];
+    if (!fgets(line, sizeof(line), video->file))
+        return 0;
+    if (strncmp(line, "FRAME", 5)) {
+        fprintf(stderr, "Error: Malformed Y4M frame header!\n");
+        return 0;
+    }
+    if (fread(video->planes, 1, video->frame_bytes, video->file) != video->frame_bytes)
+        return 0;
+
+    size_t width = video->width, height = video->height;
+    const unsigned char* luma = video->planes;
+    unsigned char* out = video->yuv.data;
+
+    if (video->chroma == Y4M_MONO) {
+        memcpy(out, luma, width * height);
+        return 1;
+    }
+
+    size_t chroma_width, chroma_height;
+    get_chroma_size(video, &chroma_width, &chroma_height);
+    const unsigned char* blue = luma + width * height;
+    const unsigned char* red = blue + chroma_width * chroma_height;
+    size_t shift_x = video->chroma == Y4M_444 ? 0 : 1;
+    size_t shift_y = video->chroma == Y4M_420 ? 1 : 0;
+
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char* luma_row = luma + y * width;
+        const unsigned char* blue_row = blue + (y >> shift_y) * chroma_width;
+        const unsigned char* red_row = red + (y >> shift_y) * chroma_width;
+        for (size_t x = 0; x < width; x++) {
+            *out++ = luma_row[x];
+            *out++ = blue_row[x >> shift_x];
+            *out++ = red_row[x >> shift_x];
+        }
+    }
+
+    return 1;
+}
+
+
+static double clamp_unit(double value) {
+    return value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+}
+
+
+// Converts BT.601 YCbCr samples to RGB in place. This is done after
+// resizing, since averaging commutes with the (linear) conversion.
+static void convert_yuv_image(image_t* image, int full_range) {
+    double luma_offset = full_range ? 0.0 : 16.0 / 255.0;
+    double luma_scale = full_range ? 1.0 : 255.0 / 219.0;
+    double chroma_scale = full_range ? 1.0 : 255.0 / 224.0;
+    size_t n_pixels = image->width * image->height;
+
+    for (size_t i = 0; i < n_pixels; i++) {
+        double* pixel = &image->data[i * image->channels];
+        double luma = (pixel[0] - luma_offset) * luma_scale;
+        if (image->channels < 3) {
+            pixel[0] = clamp_unit(luma);
+            continue;
+        }
+
+        double blue = (pixel[1] - 128.0 / 255.0) * chroma_scale;
+        double red = (pixel[2] - 128.0 / 255.0) * chroma_scale;
+        pixel[0] = clamp_unit(luma + 1.402 * red);
+        pixel[1] = clamp_unit(luma - 0.344136 * blue - 0.714136 * red);
+        pixel[2] = clamp_unit(luma + 1.772 * blue);
+    }
+}
+
+
+// Decodes the next frame and resizes it to the character grid. Returns 0
+// at the end of the video.
+static int decode_frame(video_t* video, video_frame_t* out) {
+    if (video->kind == VIDEO_GIF) {
+        animation_t* animation = &video->animation;
+        if (video->next_frame >= animation->n_frames)
+            return 0;
+
+        size_t frame_size = animation->width * animation->height * animation->channels;
+        image_u8_t source = {
+            .width = animation->width,
+            .height = animation->height,
+            .channels = animation->channels,
+            .data = animation->data + video->next_frame * frame_size
+        };
+        int delay = animation->delays ? animation->delays[video->next_frame] : 0;
+        video->next_frame++;
+
+        out->image = make_resampled_u8(&source, video->out_width, video->out_height, video->n_threads);
+        out->delay = (delay <= GIF_MIN_DELAY ? GIF_DEFAULT_DELAY : delay) / 1000.0;
+    } else {
+        if (!read_y4m_frame(video))
+            return 0;
+
+        out->image = make_resampled_u8(&video->yuv, video->out_width, video->out_height, video->n_threads);
+        if (out->image.data)
+            convert_yuv_image(&out->image, video->full_range);
+        out->delay = video->frame_time;
+    }
+
+    return out->image.data != NULL;
+}
+
+
+// Frames decoded ahead of the one being shown. Decoding runs on its own
+// thread, so it overlaps with rendering and waiting for the next deadline.
+typedef struct {
+    video_t* video;
+    video_frame_t slots[VIDEO_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    int finished;
+    int stopped;
+#ifndef _WIN32
+    int has_thread;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+} frame_queue_t;
+
+
+#ifndef _WIN32
+static void* decode_frames(void* context) {
+    frame_queue_t* queue = context;
+
+    while (1) {
+        video_frame_t decoded;
+        int has_frame = decode_frame(queue->video, &decoded);
+
+        pthread_mutex_lock(&queue->lock);
+        while (has_frame && queue->count == VIDEO_QUEUE_SIZE && !queue->stopped)
+            pthread_cond_wait(&queue->changed, &queue->lock);
+
+        if (!has_frame || queue->stopped) {
+            queue->finished = 1;
+            pthread_cond_broadcast(&queue->changed);
+            pthread_mutex_unlock(&queue->lock);
+            if (has_frame)
+                free_image(&decoded.image);
+            return NULL;
+        }
+
+        queue->slots[(queue->head + queue->count) % VIDEO_QUEUE_SIZE] = decoded;
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+#endif
+
+
+static void start_queue(frame_queue_t* queue, video_t* video) {
+    memset(queue, 0, sizeof(*queue));
+    queue->video = video;
+#ifndef _WIN32
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->has_thread = !pthread_create(&queue->thread, NULL, decode_frames, queue);
+#endif
+}
+
+
+// Takes the next decoded frame. Returns 0 at the end of the video.
+static int pop_frame(frame_queue_t* queue, video_frame_t* out) {
+#ifndef _WIN32
+    if (queue->has_thread) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == 0 && !queue->finished)
+            pthread_cond_wait(&queue->changed, &queue->lock);
+
+        int has_frame = queue->count > 0;
+        if (has_frame) {
+            *out = queue->slots[queue->head];
+            queue->head = (queue->head + 1) % VIDEO_QUEUE_SIZE;
+            queue->count--;
+            pthread_cond_broadcast(&queue->changed);
+        }
+        pthread_mutex_unlock(&queue->lock);
+        return has_frame;
+    }
+#endif
+    // Without a decoding thread, decode in place
+    return decode_frame(queue->video, out);
+}
+
+
+static void stop_queue(frame_queue_t* queue) {
+#ifndef _WIN32
+    if (queue->has_thread) {
+        pthread_mutex_lock(&queue->lock);
+        queue->stopped = 1;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+        pthread_join(queue->thread, NULL);
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+#endif
+    for (; queue->count; queue->count--) {
+        free_image(&queue->slots[queue->head].image);
+        queue->head = (queue->head + 1) % VIDEO_QUEUE_SIZE;
+    }
+}
+
+
+// Plays a GIF or Y4M video at its own frame rate, or at --fps if given.
+// Returns 1 if successful.
+int play_video(const args_t* args) {
+    video_t video = {0};
+    if (!open_video(&video, args)) {
+        close_video(&video);
+        return 0;
+    }
+
+    frame_queue_t queue;
+    start_queue(&queue, &video);
+
+    // Keys can't be read from stdin while the video is coming in on it
+    int watch_keys = video.file != stdin;
+    #ifndef _WIN32
+        if (watch_keys && isatty(STDIN_FILENO))
+            set_raw_mode();
+    #endif
+
+    pacer_t pacer = make_pacer(args->fps > 0.0 ? args->fps : 1.0);
+    pacer.watch_stdin = watch_keys;
+
+    frame_t frame = make_frame(0);
+    render_scratch_t scratch = {0};
+    size_t n_frames = 0, total_bytes = 0, saved_bytes = 0;
+    video_frame_t current;
+    char key_press = 0;
+
+    while (pop_frame(&queue, &current)) {
+        size_t saved_before = frame.saved_bytes;
+        clear_frame(&frame);
+
+        //move back up to the top of the previous frame
+        if (n_frames > 0) {
+            frame_append_string(&frame, "\x1b[");
+            frame_append_uint(&frame, get_cell_rows(&current.image, args));
+            frame_append_char(&frame, 'A');
+        }
+
+        render_image(&current.image, args, &frame, &scratch);
+        frame_reset_colors(&frame);
+        write_frame(&frame, STDOUT_FILENO);
+        pacer_frame_shown(&pacer);
+
+        total_bytes += frame.length;
+        saved_bytes += frame.saved_bytes - saved_before;
+        n_frames++;
+
+        if (args->fps <= 0.0)
+            pacer.period = current.delay;
+        free_image(&current.image);
+
+        size_t n_dropped = pacer.n_dropped;
+        if (pacer_wait(&pacer, &key_press))
+            break;
+
+        //skip the frames whose time has already passed to stay in sync
+        for (; n_dropped < pacer.n_dropped && pop_frame(&queue, &current); n_dropped++)
+            free_image(&current.image);
+    }
+
+    #ifndef _WIN32
+        if (watch_keys && isatty(STDIN_FILENO))
+            restore_mode();
+    #endif
+
+    stop_queue(&queue);
+    close_video(&video);
+
+    if (args->print_stats && n_frames) {
+        print_output_stats(total_bytes, saved_bytes, n_frames);
+        print_scratch_stats(&scratch, 1);
+        print_pacer_stats(&pacer);
+    }
+
+    free_pacer(&pacer);
+    free_render_scratch(&scratch);
+    free_frame(&frame);
+    return 1;
+}